@@ -1,10 +1,14 @@
 #include "../src/global.hh"
 #include "../src/io.hh"
 #include "../src/timing.hh"
+#include "../src/thunder_io.hh"
 #include <cstdio>
 #include <fstream>
 #include <iostream>
 #include <filesystem>
+#include <mutex>
+#include <sstream>
+#include <thread>
 #include "argparse/argparse.hpp"
 
 using namespace std;
@@ -19,6 +23,27 @@ inline bool exists(const std::string &filename) {
 void setup_argparse(argparse::ArgumentParser &parser) {
     parser.add_argument("--pd").help("If set, will use PD-oriented routing strategy").default_value(
             false).implicit_value(true);
+    parser.add_argument("--lookahead").help(
+            "If set, will use routing lookahead tables as A* heuristic. "
+            "The tables are stored next to the graph files").default_value(false).implicit_value(true);
+    parser.add_argument("--bbox-margin").help(
+            "Margin in tiles added to the net bounding box that limits the search").default_value<uint32_t>(3)
+            .action([](const std::string &value) -> uint32_t { return std::stoul(value); });
+    parser.add_argument("--bbox-growth").help(
+            "Factor the bounding box margin grows by when a sink is unreachable").default_value<double>(2)
+            .action([](const std::string &value) -> double { return std::stod(value); });
+    parser.add_argument("--two-level").help(
+            "If set, nets are routed on a coarse tile grid first and the detailed search is limited to "
+            "the tiles of the coarse routes").default_value(false).implicit_value(true);
+    parser.add_argument("-j", "--threads").help(
+            "Number of threads used to route nets concurrently").default_value<uint32_t>(1)
+            .action([](const std::string &value) -> uint32_t { return std::stoul(value); });
+    parser.add_argument("--telemetry").help(
+            "If set, per-iteration routing statistics are written to the file as JSON lines").default_value<std::string>(
+            "");
+    parser.add_argument("--timing-driven").help(
+            "If set, the connection criticality comes from a timing analysis over the routes. "
+            "Requires the chip layout").default_value(false).implicit_value(true);
     parser.add_argument("-p", "--packed").help("Packed netlist file").required();
     parser.add_argument("-P", "--placement").help("Placement file").required();
     parser.add_argument("-o", "-r", "--route").help("Routing result").required();
@@ -35,6 +60,13 @@ void setup_argparse(argparse::ArgumentParser &parser) {
 
 struct RouterInput {
     bool pd = false;
+    bool lookahead = false;
+    bool two_level = false;
+    uint32_t bbox_margin = 3;
+    double bbox_growth = 2;
+    uint32_t num_threads = 1;
+    bool timing_driven = false;
+    std::string telemetry_filename;
     std::string packed_filename;
     std::string placement_filename;
     std::string output_file;
@@ -60,6 +92,17 @@ std::optional<RouterInput> parse_args(int argc, char *argv[]) {
     // fill out information
     RouterInput result;
     result.pd = parser["--pd"] == true;
+    result.lookahead = parser["--lookahead"] == true;
+    result.two_level = parser["--two-level"] == true;
+    result.bbox_margin = parser.get<uint32_t>("--bbox-margin");
+    result.bbox_growth = parser.get<double>("--bbox-growth");
+    result.num_threads = std::max(parser.get<uint32_t>("-j"), 1u);
+    if (result.bbox_growth < 1) {
+        std::cerr << "Bounding box growth factor has to be at least 1" << std::endl;
+        std::cerr << parser << std::endl;
+        return std::nullopt;
+    }
+    result.telemetry_filename = parser.get<std::string>("--telemetry");
     result.packed_filename = parser.get<std::string>("-p");
     result.placement_filename = parser.get<std::string>("-P");
     result.output_file = parser.get<std::string>("-o");
@@ -71,11 +114,13 @@ std::optional<RouterInput> parse_args(int argc, char *argv[]) {
         result.graph_info.emplace_back(std::make_pair(bit_width, value));
     }
 
+    result.timing_driven = parser["--timing-driven"] == true;
     auto timing_file = parser.get<std::string>("-t");
-    if (timing_file != "none") {
+    if (timing_file != "none" || result.timing_driven) {
         auto layout = parser.get<std::string>("-l");
         if (layout.empty()) {
-            std::cerr << "When re-timing is specified, layout file is required" << std::endl;
+            std::cerr << "When re-timing or timing-driven routing is specified, layout file is required"
+                      << std::endl;
             std::cerr << parser << std::endl;
             return std::nullopt;
         }
@@ -89,26 +134,74 @@ std::optional<RouterInput> parse_args(int argc, char *argv[]) {
 }
 
 void
-adjust_node_cost_power_domain(RoutingGraph *graph,
+adjust_node_cost_power_domain(Router *router,
                               const std::map<std::string, std::pair<int, int>> &placement_result) {
     ::set<std::pair<uint32_t, uint32_t>> locations;
     for (auto const &iter: placement_result) {
         locations.emplace(iter.second);
     }
 
-    // adjust the nodes cost, if any node is not on the placed tiles, we increase the cost
-    for (auto const &[loc, tile]: *graph) {
-        if (locations.find(loc) == locations.end()) {
-            // increase the cost for all nodes
-            auto switchbox = tile.switchbox;
-            for (uint32_t i = 0; i < 4; i++) {
-                auto sbs = switchbox.get_sbs_by_side(SwitchBoxSide(i));
-                for (const auto &sb: sbs) {
-                    sb->delay = power_domain_cost;
-                }
-            }
+    // adjust the nodes cost, if any node is not on the placed tiles, we increase the cost.
+    // notice that this only changes the router's view of the graph
+    auto const &graph = *router->get_graph();
+    for (uint32_t id = 0; id < graph.size(); id++) {
+        auto const &node = graph.get_node(id);
+        if (!node || graph.type(id) != NodeType::SwitchBox)
+            continue;
+        if (locations.find({graph.x(id), graph.y(id)}) == locations.end()) {
+            router->set_node_delay(node, power_domain_cost);
+        }
+    }
+}
+
+// the routers run concurrently, hence the lock
+struct Telemetry {
+    std::ofstream out;
+    std::mutex mutex;
+};
+
+std::string json_string(const std::string &str) {
+    std::string result = "\"";
+    for (auto c: str) {
+        if (c == '"' || c == '\\') {
+            result += '\\';
+            result += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+            result += buf;
+        } else {
+            result += c;
         }
     }
+    return result + "\"";
+}
+
+void write_telemetry(Telemetry &telemetry, uint32_t bit_width, const IterationStats &stats) {
+    std::ostringstream line;
+    line << "{\"bit_width\": " << bit_width
+         << ", \"iteration\": " << stats.iteration
+         << ", \"duration_ms\": " << stats.duration
+         << ", \"overused_nodes\": " << stats.overused_nodes
+         << ", \"total_overuse\": " << stats.total_overuse
+         << ", \"nets_rerouted\": " << stats.nets_rerouted
+         << ", \"searches\": " << stats.searches
+         << ", \"nodes_expanded\": " << stats.nodes_expanded
+         << ", \"heap_pushes\": " << stats.heap_pushes
+         << ", \"routes_reused\": " << stats.routes_reused
+         << ", \"overused_channels\": " << stats.overused_channels
+         << ", \"corridor_misses\": " << stats.corridor_misses
+         << ", \"pn\": " << stats.pn
+         << ", \"slowest_nets\": [";
+    for (uint64_t i = 0; i < stats.slowest_nets.size(); i++) {
+        auto const &[name, time] = stats.slowest_nets[i];
+        if (i)
+            line << ", ";
+        line << "{\"net\": " << json_string(name) << ", \"duration_ms\": " << time << "}";
+    }
+    line << "]}";
+    std::lock_guard<std::mutex> guard(telemetry.mutex);
+    telemetry.out << line.str() << std::endl;
 }
 
 void retime_router(std::map<uint32_t, std::unique_ptr<Router>> &routers, const RouterInput &args) {
@@ -136,6 +229,61 @@ void retime_router(std::map<uint32_t, std::unique_ptr<Router>> &routers, const R
     }
 }
 
+std::unique_ptr<Router>
+route_bit_width(const std::pair<uint32_t, std::string> &graph_info, int net_id_base,
+                const std::map<std::string, std::vector<std::pair<std::string, std::string>>> &netlist,
+                const std::map<std::string, uint32_t> &track_mode,
+                const std::map<std::string, std::pair<int, int>> &placement,
+                const RouterInput &args, const Layout *layout, Telemetry *telemetry) {
+    auto const &[bit_width, graph_filename] = graph_info;
+    // the compiled graph is read-only and can be shared among routers
+    auto graph = std::make_shared<const CompiledGraph>(load_routing_graph(graph_filename));
+
+    // set up the router
+    auto r = std::make_unique<GlobalRouter>(50, graph);
+    if (args.lookahead)
+        r->set_lookahead(load_lookahead(graph, graph_filename));
+    r->bbox_margin = args.bbox_margin;
+    r->bbox_growth = args.bbox_growth;
+    r->num_threads = args.num_threads;
+    r->two_level = args.two_level;
+    r->set_net_id_base(net_id_base);
+    if (layout) {
+        r->timing_driven = true;
+        r->set_timing_delays(get_node_timing_delays(*graph, *layout, get_default_timing_info()));
+    }
+    if (telemetry) {
+        auto const width = bit_width;
+        r->set_iteration_callback([telemetry, width](const IterationStats &stats) {
+            write_telemetry(*telemetry, width, stats);
+        });
+    }
+
+    // adjust the node cost
+    if (args.pd) {
+        cout << ("Adjusting power domain cost for bit_width " + std::to_string(bit_width) + "\n");
+        adjust_node_cost_power_domain(r.get(), placement);
+    }
+    for (auto const &it: placement) {
+        auto[x, y] = it.second;
+        r->add_placement(x, y, it.first);
+    }
+
+    for (const auto &iter: netlist) {
+        // Note
+        // we only route 1bit at this time
+        if (track_mode.at(iter.first) == bit_width)
+            r->add_net(iter.first, iter.second);
+    }
+
+    r->route();
+    if (layout) {
+        cout << ("Critical path delay for bit_width " + std::to_string(bit_width) + ": " +
+                 std::to_string(r->get_critical_path_delay()) + "\n");
+    }
+    return r;
+}
+
 int main(int argc, char *argv[]) {
     auto args_opt = parse_args(argc, argv);
     if (!args_opt) {
@@ -143,7 +291,6 @@ int main(int argc, char *argv[]) {
     }
     auto const &args = *args_opt;
 
-    bool power_domain = args.pd;
     const auto &packed_filename = args.packed_filename;
     auto const &placement_filename = args.placement_filename;
 
@@ -159,35 +306,55 @@ int main(int argc, char *argv[]) {
         }
     }
 
-    std::map<uint32_t, std::unique_ptr<Router>> routers;
-    for (auto const &[bit_width, graph_filename]: args.graph_info) {
-        cout << "using bit_width " << bit_width << endl;
-        auto graph = load_routing_graph(graph_filename);
-
-        // adjust the node cost
-        if (power_domain) {
-            cout << "Adjusting power domain cost for bit_width " << bit_width << endl;
-            adjust_node_cost_power_domain(&graph, placement);
-        }
-
-        // set up the router
-        auto r = std::make_unique<GlobalRouter>(50, graph);
-        for (auto const &it: placement) {
-            auto[x, y] = it.second;
-            r->add_placement(x, y, it.first);
+    // the graphs don't share any routing resource, so each of them is loaded
+    // and routed on its own thread. net ids are given out in ranges per
+    // bit width to keep them unique and deterministic
+    auto const num_graphs = args.graph_info.size();
+    std::vector<std::unique_ptr<Router>> results(num_graphs);
+    std::vector<std::exception_ptr> errors(num_graphs);
+    std::vector<std::thread> threads;
+    std::unique_ptr<Telemetry> telemetry;
+    if (!args.telemetry_filename.empty()) {
+        telemetry = std::make_unique<Telemetry>();
+        telemetry->out.open(args.telemetry_filename);
+        if (!telemetry->out.good()) {
+            cerr << "Unable to open " << args.telemetry_filename << endl;
+            return EXIT_FAILURE;
         }
-
-        for (const auto &iter: netlist) {
-            // Note
-            // we only route 1bit at this time
+    }
+    // the layout is only needed to look up the node delays
+    std::unique_ptr<Layout> layout;
+    if (args.timing_driven)
+        layout = std::make_unique<Layout>(load_layout(args.chip_layout));
+    int net_id_base = 0;
+    for (uint64_t i = 0; i < num_graphs; i++) {
+        auto const bit_width = args.graph_info[i].first;
+        cout << "using bit_width " << bit_width << endl;
+        // structured bindings can't be captured directly in c++17
+        threads.emplace_back([&, i, net_id_base, &nets = netlist, &modes = track_mode]() {
+            try {
+                results[i] = route_bit_width(args.graph_info[i], net_id_base,
+                                             nets, modes, placement, args,
+                                             layout.get(), telemetry.get());
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        });
+        for (auto const &iter: netlist) {
             if (track_mode.at(iter.first) == bit_width)
-                r->add_net(iter.first, iter.second);
+                net_id_base++;
         }
-
-        r->route();
-
-        routers.emplace(bit_width, std::move(r));
     }
+    for (auto &thread: threads)
+        thread.join();
+    for (auto const &error: errors) {
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+    std::map<uint32_t, std::unique_ptr<Router>> routers;
+    for (uint64_t i = 0; i < num_graphs; i++)
+        routers.emplace(args.graph_info[i].first, std::move(results[i]));
 
     retime_router(routers, args);
 
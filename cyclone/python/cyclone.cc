@@ -1,4 +1,5 @@
 #include <pybind11/pybind11.h>
+#include <pybind11/functional.h>
 #include <pybind11/stl.h>
 #include <sstream>
 #include "../src/graph.hh"
@@ -25,6 +26,7 @@ void init_node_class(py::class_<T, std::shared_ptr<T>> &class_) {
         .def_readwrite("width", &T::width)
         .def_readwrite("delay", &T::delay)
         .def_readwrite("track", &T::track)
+        .def_readonly("id", &T::id)
         .def("size", &T::size)
         .def("add_edge",
            py::overload_cast<const std::shared_ptr<Node> &>(&Node::add_edge))
@@ -43,6 +45,9 @@ void init_router_class(py::class_<T> &class_) {
         .def("add_net", &T::add_net)
         .def("add_placement", &T::add_placement)
         .def("overflow", &T::overflow)
+        .def("get_overused_nodes", &T::get_overused_nodes)
+        .def("get_total_overuse", &T::get_total_overuse)
+        .def("get_congested_nets", &T::get_congested_nets)
         .def("route", &T::route)
         .def("realize", &T::realize)
         // getter & setter
@@ -50,7 +55,18 @@ void init_router_class(py::class_<T> &class_) {
         .def("set_init_pn", &T::set_init_pn)
         .def("get_pn_factor", &T::get_pn_factor)
         .def("set_pn_factor", &T::set_pn_factor)
-        .def("get_netlist", &T::get_netlist);
+        .def("set_node_delay", &T::set_node_delay)
+        .def("get_node_delay", &T::get_node_delay)
+        .def("set_lookahead", [](T &router,
+                                 const std::shared_ptr<Lookahead> &lookahead) {
+            router.set_lookahead(lookahead);
+        })
+        .def("get_netlist", &T::get_netlist)
+        .def("set_net_id_base", &T::set_net_id_base)
+        .def("get_nodes_expanded", &T::get_nodes_expanded)
+        .def("get_last_nodes_expanded", &T::get_last_nodes_expanded)
+        .def("get_num_searches", &T::get_num_searches)
+        .def("get_heap_pushes", &T::get_heap_pushes);
 }
 
 void init_netlist(py::module &m) {
@@ -65,6 +81,7 @@ void init_netlist(py::module &m) {
         .def_readwrite("fixed", &Net::fixed)
         .def_readwrite("id", &Net::id)
         .def("add_pin", &Net::add_pin)
+        .def("clear_pin_order", &Net::clear_pin_order)
         .def("__iter__", [](Net &net) {
             return py::make_iterator(net.begin(), net.end());
         }, py::keep_alive<0, 1>());
@@ -201,7 +218,9 @@ void init_graph(py::module &m) {
     py::class_<RoutingGraph>(m, "RoutingGraph")
         .def(py::init<>())
         .def(py::init<uint32_t, uint32_t, const Switch &>())
-        .def("add_tile", &RoutingGraph::add_tile)
+        .def("add_tile",
+             py::overload_cast<const Tile &>(&RoutingGraph::add_tile))
+        .def("num_nodes", &RoutingGraph::num_nodes)
         .def("remove_tile", &RoutingGraph::remove_tile)
         .def("add_edge",
              py::overload_cast<const Node &,
@@ -248,14 +267,65 @@ void init_graph(py::module &m) {
 }
 
 void init_router(py::module &m) {
+    // read-only graph that can be shared among routers
+    py::class_<CompiledGraph, std::shared_ptr<CompiledGraph>>(m, "CompiledGraph")
+        .def(py::init<const RoutingGraph &>())
+        .def("size", &CompiledGraph::size)
+        .def("num_edges", &CompiledGraph::num_edges);
+
+    py::class_<Lookahead, std::shared_ptr<Lookahead>>(m, "Lookahead")
+        .def(py::init([](const std::shared_ptr<CompiledGraph> &graph) {
+            return std::make_shared<Lookahead>(graph);
+        }))
+        .def("estimate", py::overload_cast<uint32_t, uint32_t>(
+                &Lookahead::estimate, py::const_))
+        .def("num_rows", &Lookahead::num_rows)
+        .def("dump", &Lookahead::dump);
+
     py::class_<Router> router(m, "Router");
     router.def(py::init<RoutingGraph>());
+    router.def(py::init([](const std::shared_ptr<CompiledGraph> &graph) {
+        return new Router(graph);
+    }));
     init_router_class<Router>(router);
 
+    py::class_<IterationStats>(m, "IterationStats")
+        .def_readonly("iteration", &IterationStats::iteration)
+        .def_readonly("duration", &IterationStats::duration)
+        .def_readonly("overused_nodes", &IterationStats::overused_nodes)
+        .def_readonly("total_overuse", &IterationStats::total_overuse)
+        .def_readonly("nets_rerouted", &IterationStats::nets_rerouted)
+        .def_readonly("searches", &IterationStats::searches)
+        .def_readonly("nodes_expanded", &IterationStats::nodes_expanded)
+        .def_readonly("heap_pushes", &IterationStats::heap_pushes)
+        .def_readonly("routes_reused", &IterationStats::routes_reused)
+        .def_readonly("overused_channels", &IterationStats::overused_channels)
+        .def_readonly("corridor_misses", &IterationStats::corridor_misses)
+        .def_readonly("pn", &IterationStats::pn)
+        .def_readonly("slowest_nets", &IterationStats::slowest_nets);
+
     py::class_<GlobalRouter> gr(m, "GlobalRouter", router);
     gr.def(py::init<uint32_t, RoutingGraph>())
+      .def(py::init([](uint32_t num_iteration,
+                       const std::shared_ptr<CompiledGraph> &graph) {
+          return new GlobalRouter(num_iteration, graph);
+      }))
       .def_readwrite("route_strategy_ratio",
-                     &GlobalRouter::route_strategy_ratio);
+                     &GlobalRouter::route_strategy_ratio)
+      .def_readwrite("bbox_margin", &GlobalRouter::bbox_margin)
+      .def_readwrite("bbox_growth", &GlobalRouter::bbox_growth)
+      .def_readwrite("incremental_reroute",
+                     &GlobalRouter::incremental_reroute)
+      .def_readwrite("num_threads", &GlobalRouter::num_threads)
+      .def_readwrite("num_slowest_nets", &GlobalRouter::num_slowest_nets)
+      .def_readwrite("timing_driven", &GlobalRouter::timing_driven)
+      .def_readwrite("reuse_routes", &GlobalRouter::reuse_routes)
+      .def_readwrite("two_level", &GlobalRouter::two_level)
+      .def_readwrite("corridor_margin", &GlobalRouter::corridor_margin)
+      .def("set_timing_delays", &GlobalRouter::set_timing_delays)
+      .def("get_critical_path_delay", &GlobalRouter::get_critical_path_delay)
+      .def("set_iteration_callback", &GlobalRouter::set_iteration_callback)
+      .def("get_iteration_stats", &GlobalRouter::get_iteration_stats);
     init_router_class<GlobalRouter>(gr);
 }
 
@@ -297,6 +367,11 @@ void init_io(py::module &m) {
     auto io_m = m.def_submodule("io");
     io_m.def("dump_routing_graph", &dump_routing_graph)
         .def("load_routing_graph", &load_routing_graph)
+        .def("load_lookahead", [](const std::shared_ptr<CompiledGraph> &graph,
+                                  const std::string &graph_filename) {
+            return std::const_pointer_cast<Lookahead>(
+                    load_lookahead(graph, graph_filename));
+        })
         .def("load_placement", &load_placement)
         .def("load_netlist", &load_netlist)
         .def("dump_routing_result", &dump_routing_result)
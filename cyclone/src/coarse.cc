@@ -0,0 +1,257 @@
+#include "coarse.hh"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+using std::pair;
+using std::vector;
+using std::runtime_error;
+
+CoarseRouter::CoarseRouter(const CompiledGraph &graph)
+    : width_(graph.width()), height_(graph.height()) {
+    auto const num_channels = static_cast<uint64_t>(width_) * height_ * SIDES;
+    capacity_.assign(num_channels, 0);
+    usage_.assign(num_channels, 0);
+    history_.assign(num_channels, 0);
+
+    // every outgoing switch box track wired to the neighbor tile counts once,
+    // which gives num_track or num_horizontal_track of the switch, minus the
+    // tracks that are removed or not wired
+    for (uint32_t id = 0; id < graph.size(); id++) {
+        if (!graph.get_node(id) || graph.type(id) != NodeType::SwitchBox ||
+            graph.io(id) != SwitchBoxIO::SB_OUT)
+            continue;
+        auto const from = tile(graph.x(id), graph.y(id));
+        for (auto const &edge : graph.edges(id)) {
+            uint32_t to;
+            bool found = false;
+            for (uint32_t side = 0; side < SIDES && !found; side++) {
+                if (neighbor(from, side, to) &&
+                    to == tile(graph.x(edge.node), graph.y(edge.node))) {
+                    capacity_[from * SIDES + side]++;
+                    found = true;
+                }
+            }
+            if (found)
+                break;
+        }
+    }
+
+    auto const num_tiles = width_ * height_;
+    open_list_.reserve(num_tiles);
+    g_score_.assign(num_tiles, 0);
+    trace_.assign(num_tiles, 0);
+    visited_.assign(num_tiles, false);
+}
+
+bool CoarseRouter::neighbor(uint32_t tile, uint32_t side,
+                            uint32_t &result) const {
+    auto const x = tile % width_;
+    auto const y = tile / width_;
+    // same order as SwitchBoxSide
+    switch (side) {
+        case 0:
+            if (x + 1 >= width_) return false;
+            result = tile + 1;
+            return true;
+        case 1:
+            if (y + 1 >= height_) return false;
+            result = tile + width_;
+            return true;
+        case 2:
+            if (x == 0) return false;
+            result = tile - 1;
+            return true;
+        case 3:
+            if (y == 0) return false;
+            result = tile - width_;
+            return true;
+        default:
+            return false;
+    }
+}
+
+uint32_t CoarseRouter::capacity(uint32_t x, uint32_t y,
+                                SwitchBoxSide side) const {
+    if (x >= width_ || y >= height_)
+        return 0;
+    return capacity_[tile(x, y) * SIDES + static_cast<uint32_t>(side)];
+}
+
+uint32_t CoarseRouter::usage(uint32_t x, uint32_t y,
+                             SwitchBoxSide side) const {
+    if (x >= width_ || y >= height_)
+        return 0;
+    return usage_[tile(x, y) * SIDES + static_cast<uint32_t>(side)];
+}
+
+void CoarseRouter::route_net(int net_id,
+                             const ::vector<::pair<uint32_t, uint32_t>> &pins,
+                             double pn) {
+    rip_up_net(net_id);
+    if (pins.empty())
+        return;
+    for (auto const &[x, y] : pins) {
+        if (x >= width_ || y >= height_)
+            throw ::runtime_error("pin outside of the coarse grid");
+    }
+
+    NetRoute route;
+    route.src = tile(pins[0].first, pins[0].second);
+    ::vector<uint32_t> tree = {route.src};
+    for (uint64_t i = 1; i < pins.size(); i++) {
+        auto const sink = tile(pins[i].first, pins[i].second);
+        auto path = route_connection(tree, sink, route.channels, pn);
+        for (uint64_t j = 1; j < path.size(); j++) {
+            for (uint32_t side = 0; side < SIDES; side++) {
+                uint32_t next;
+                if (!neighbor(path[j - 1], side, next) || next != path[j])
+                    continue;
+                auto const channel = path[j - 1] * SIDES + side;
+                auto const pos = std::lower_bound(route.channels.begin(),
+                                                  route.channels.end(),
+                                                  channel);
+                if (pos == route.channels.end() || *pos != channel)
+                    route.channels.insert(pos, channel);
+                break;
+            }
+            tree.emplace_back(path[j]);
+        }
+        route.paths.emplace_back(std::move(path));
+    }
+    for (auto const channel : route.channels)
+        usage_[channel]++;
+    routes_.emplace(net_id, std::move(route));
+}
+
+::vector<uint32_t>
+CoarseRouter::route_connection(const ::vector<uint32_t> &tree, uint32_t sink,
+                               const ::vector<uint32_t> &used, double pn) {
+    auto heuristic = [&](uint32_t tile) -> double {
+        auto const x = tile % width_, y = tile / width_;
+        auto const sx = sink % width_, sy = sink / width_;
+        return (x > sx ? x - sx : sx - x) + (y > sy ? y - sy : sy - y);
+    };
+    // every hop costs at least 1, so the manhattan distance is a lower bound.
+    // channels the net already uses don't add to the presence cost
+    auto cost = [&](uint32_t channel) -> double {
+        double p = 1;
+        if (!std::binary_search(used.begin(), used.end(), channel) &&
+            usage_[channel] + 1 > capacity_[channel])
+            p += pn * (usage_[channel] + 1 - capacity_[channel]);
+        return (1 + hn_factor * history_[channel]) * p;
+    };
+
+    constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+    open_list_.clear();
+    std::fill(visited_.begin(), visited_.end(), false);
+    for (auto const tile : tree) {
+        if (open_list_.contains(tile))
+            continue;
+        g_score_[tile] = 0;
+        trace_[tile] = NONE;
+        open_list_.push(tile, heuristic(tile));
+    }
+
+    bool reached = false;
+    while (!open_list_.empty()) {
+        auto const head = open_list_.top();
+        if (head == sink) {
+            reached = true;
+            break;
+        }
+        open_list_.pop();
+        visited_[head] = true;
+        for (uint32_t side = 0; side < SIDES; side++) {
+            auto const channel = head * SIDES + side;
+            uint32_t next;
+            if (capacity_[channel] == 0 || !neighbor(head, side, next) ||
+                visited_[next])
+                continue;
+            auto const score = g_score_[head] + cost(channel);
+            if (!open_list_.contains(next)) {
+                g_score_[next] = score;
+                trace_[next] = head;
+                open_list_.push(next, score + heuristic(next));
+            } else if (score < g_score_[next]) {
+                g_score_[next] = score;
+                trace_[next] = head;
+                open_list_.decrease(next, score + heuristic(next));
+            }
+        }
+    }
+
+    // unreachable sinks only get their own tile. the detailed router falls
+    // back to the bounding box for them
+    if (!reached)
+        return {sink};
+    ::vector<uint32_t> path;
+    for (auto tile = sink; tile != NONE; tile = trace_[tile])
+        path.emplace_back(tile);
+    std::reverse(path.begin(), path.end());
+    return path;
+}
+
+void CoarseRouter::rip_up_net(int net_id) {
+    auto iter = routes_.find(net_id);
+    if (iter == routes_.end())
+        return;
+    for (auto const channel : iter->second.channels)
+        usage_[channel]--;
+    routes_.erase(iter);
+}
+
+TileMask CoarseRouter::get_corridor(int net_id, uint64_t num_connections,
+                                    uint32_t margin) const {
+    TileMask result(width_, height_);
+    auto iter = routes_.find(net_id);
+    if (iter == routes_.end())
+        return result;
+    auto const &[src, paths, channels] = iter->second;
+    auto add = [&](uint32_t tile) {
+        auto const x = tile % width_, y = tile / width_;
+        auto const xmin = x > margin ? x - margin : 0;
+        auto const ymin = y > margin ? y - margin : 0;
+        for (auto i = xmin; i <= x + margin && i < width_; i++) {
+            for (auto j = ymin; j <= y + margin && j < height_; j++)
+                result.add(i, j);
+        }
+    };
+    add(src);
+    num_connections = std::min<uint64_t>(num_connections, paths.size());
+    for (uint64_t i = 0; i < num_connections; i++) {
+        for (auto const tile : paths[i])
+            add(tile);
+    }
+    return result;
+}
+
+void CoarseRouter::assign_history(
+        const ::vector<::pair<uint32_t, uint32_t>> &congested_tiles) {
+    for (uint64_t channel = 0; channel < usage_.size(); channel++) {
+        if (usage_[channel] > capacity_[channel])
+            history_[channel] += usage_[channel] - capacity_[channel];
+    }
+    for (auto const &[x, y] : congested_tiles) {
+        if (x >= width_ || y >= height_)
+            continue;
+        auto const to = tile(x, y);
+        for (uint32_t side = 0; side < SIDES; side++) {
+            uint32_t from;
+            if (!neighbor(to, side, from))
+                continue;
+            // the channel from the neighbor back into this tile
+            auto const back = (side + SIDES / 2) % SIDES;
+            history_[from * SIDES + back]++;
+        }
+    }
+}
+
+uint32_t CoarseRouter::get_overused_channels() const {
+    uint32_t result = 0;
+    for (uint64_t channel = 0; channel < usage_.size(); channel++) {
+        if (usage_[channel] > capacity_[channel])
+            result++;
+    }
+    return result;
+}
@@ -0,0 +1,88 @@
+#ifndef CYCLONE_COARSE_HH
+#define CYCLONE_COARSE_HH
+
+#include <map>
+#include <utility>
+#include <vector>
+#include "heap.hh"
+#include "route.hh"
+
+// first stage of the two-level routing, see GlobalRouter::two_level.
+// the array is abstracted into a channel graph where every tile is a node and
+// adjacent tiles are linked by a channel in each direction. the capacity of a
+// channel is the number of outgoing switch box tracks wired to the neighbor,
+// i.e. num_horizontal_track on the left and right of tall switch boxes and
+// num_track otherwise, less the tracks that are removed or not wired.
+// channels without any wire between the two tiles are left out.
+// nets are routed on it with PathFinder costs, where a net uses a channel at
+// most once no matter how many of its connections go through it. the tiles
+// of the coarse route form the corridor the detailed search is limited to
+class CoarseRouter {
+public:
+    explicit CoarseRouter(const CompiledGraph &graph);
+
+    uint32_t width() const { return width_; }
+    uint32_t height() const { return height_; }
+    // number of tracks from the tile to its neighbor on the side, 0 if they
+    // are not connected
+    uint32_t capacity(uint32_t x, uint32_t y, SwitchBoxSide side) const;
+    // number of nets that use the channel
+    uint32_t usage(uint32_t x, uint32_t y, SwitchBoxSide side) const;
+
+    // routes the src, i.e. the first pin, to every sink in the given order.
+    // a connection starts from any tile already on the coarse route of the
+    // net. the previous route of the net is ripped up first
+    void route_net(int net_id,
+                   const std::vector<std::pair<uint32_t, uint32_t>> &pins,
+                   double pn);
+    void rip_up_net(int net_id);
+    // tiles of the src and the first num_connections connections of the net,
+    // widened by margin tiles
+    TileMask get_corridor(int net_id, uint64_t num_connections,
+                          uint32_t margin) const;
+
+    // overused channels get their overuse added to the history, and the
+    // channels into the congested tiles, e.g. the ones with overused nodes
+    // in the detailed routes, get one more
+    void assign_history(
+            const std::vector<std::pair<uint32_t, uint32_t>> &congested_tiles);
+    // channels used by more nets than their capacity
+    uint32_t get_overused_channels() const;
+
+    double hn_factor = 0.5;
+
+private:
+    static constexpr uint32_t SIDES = 4;
+
+    struct NetRoute {
+        uint32_t src = 0;
+        // tiles of every connection, from the branch tile to the sink
+        std::vector<std::vector<uint32_t>> paths;
+        // sorted
+        std::vector<uint32_t> channels;
+    };
+
+    uint32_t width_ = 0;
+    uint32_t height_ = 0;
+    // indexed by tile * SIDES + side
+    std::vector<uint32_t> capacity_;
+    std::vector<uint32_t> usage_;
+    std::vector<uint32_t> history_;
+    std::map<int, NetRoute> routes_;
+
+    // search tables, indexed by tile
+    IndexedHeap<double> open_list_;
+    std::vector<double> g_score_;
+    std::vector<uint32_t> trace_;
+    std::vector<bool> visited_;
+
+    uint32_t tile(uint32_t x, uint32_t y) const { return y * width_ + x; }
+    // neighbor of the tile on the side, if it's in the grid
+    bool neighbor(uint32_t tile, uint32_t side, uint32_t &result) const;
+    std::vector<uint32_t> route_connection(const std::vector<uint32_t> &tree,
+                                           uint32_t sink,
+                                           const std::vector<uint32_t> &used,
+                                           double pn);
+};
+
+#endif //CYCLONE_COARSE_HH
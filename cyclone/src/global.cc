@@ -5,7 +5,9 @@
 #include <iomanip>
 #include <ctime>
 #include <queue>
+#include <sstream>
 #include "global.hh"
+#include "thread_pool.hh"
 #include "util.hh"
 
 using std::map;
@@ -18,6 +20,7 @@ using std::string;
 using std::function;
 using std::move;
 using std::setw;
+using std::unique_ptr;
 
 // routing strategy
 enum class RoutingStrategy {
@@ -43,37 +46,143 @@ void GlobalRouter::route() {
     squash_non_broadcast_reg_nets();
     group_reg_nets();
     auto reordered_netlist = reorder_reg_nets();
+    // nets linked by registers have to be rerouted together since the
+    // register locations are assigned on the fly
+    ::map<int, const ::vector<int> *> reg_chains;
+    for (auto const &[src_id, chain] : reg_net_order_) {
+        for (auto const net_id : chain)
+            reg_chains.emplace(net_id, &chain);
+    }
+    ::set<int> reroute_nets;
+    // nets are routed in units of a reg net chain or a single net, in
+    // routing order
+    ::vector<::vector<int>> units;
+    const ::vector<int> *last_chain = nullptr;
+    for (auto const net_id : reordered_netlist) {
+        auto iter = reg_chains.find(net_id);
+        auto const *chain = iter == reg_chains.end() ? nullptr : iter->second;
+        if (chain == nullptr || chain != last_chain)
+            units.emplace_back();
+        units.back().emplace_back(net_id);
+        last_chain = chain;
+    }
+    // a single thread routes the nets one by one, with the search region
+    // growing up to the whole array
+    ::unique_ptr<ThreadPool> pool;
+    if (num_threads > 1)
+        pool = std::make_unique<ThreadPool>(num_threads);
+    ::vector<const ::vector<int> *> current_units;
+    iteration_stats_.clear();
+    net_durations_.clear();
+    for (auto const &[net_id, net] : netlist_)
+        net_durations_.emplace(net_id, 0);
+    if (timing_driven)
+        build_timing_graph();
+    build_route_classes();
+    if (two_level)
+        coarse_router_ = std::make_unique<CoarseRouter>(*graph_);
+    else
+        coarse_router_.reset();
 
     for (uint32_t it = 0; it < num_iteration_; it++) {
         auto time_start = std::chrono::system_clock::now();
-
-        std::cout << "Routing iteration: " << ::setw(3) << it;
+        uint64_t const nodes_expanded = nodes_expanded_;
+        uint64_t const num_searches = num_searches_;
+        uint64_t const heap_pushes = heap_pushes_;
+        uint32_t const routes_reused = routes_reused_;
+        uint64_t const corridor_misses = corridor_misses_;
+        for (auto &iter : net_durations_)
+            iter.second = 0;
 
         // update the slack ratio table
         compute_slack_ratio(it);
-        overflowed_ = false;
 
         // clear the routing resources, i.e. rip up all the nets
         //clear_connections();
 
-        for (const auto &net_id : reordered_netlist) {
-            // TODO:
-            //     rip up linked reg-net as well
-            rip_up_net(net_id);
-            route_net(net_id, it);
+        // after the first iteration only the nets that use overflowed nodes
+        // are ripped up, along with their linked reg nets. the rest keep
+        // their routes and their share of the presence cost
+        if (it > 0 && incremental_reroute) {
+            reroute_nets.clear();
+            for (auto const net_id : get_congested_nets()) {
+                auto iter = reg_chains.find(net_id);
+                if (iter == reg_chains.end()) {
+                    reroute_nets.emplace(net_id);
+                } else {
+                    for (auto const id : *iter->second)
+                        reroute_nets.emplace(id);
+                }
+            }
+        }
+
+        // chains are either rerouted as a whole or not at all
+        current_units.clear();
+        for (auto const &unit : units) {
+            if (it > 0 && incremental_reroute &&
+                reroute_nets.find(unit.front()) == reroute_nets.end())
+                continue;
+            current_units.emplace_back(&unit);
+        }
+
+        // the coarse routes of all the nets are known before any detailed
+        // search starts
+        if (coarse_router_)
+            route_coarse(current_units, it);
+
+        if (pool) {
+            route_units(current_units, it, *pool);
+        } else {
+            for (auto const *unit : current_units) {
+                for (auto const net_id : *unit) {
+                    reset_net(net_id);
+                    route_net_timed(net_id, it);
+                    record_route_pattern(net_id);
+                }
+            }
+        }
+        if (timing_driven) {
+            for (auto const *unit : current_units)
+                timing_dirty_nets_.insert(unit->begin(), unit->end());
         }
 
         // assign history table
         assign_history();
+        if (coarse_router_)
+            assign_coarse_history();
 
         auto time_end = std::chrono::system_clock::now();
         // compute the duration
         auto duration =
                 std::chrono::duration_cast<
                         std::chrono::milliseconds>(time_end - time_start);
-        std::cout << " duration: " << duration.count() << " ms" << std::endl;
+        // the line is written at once since several routers may run at the
+        // same time
+        std::ostringstream line;
+        line << "Routing iteration: " << ::setw(3) << it
+             << " duration: " << duration.count() << " ms"
+             << " expanded: " << nodes_expanded_ - nodes_expanded
+             << std::endl;
+        std::cout << line.str() << std::flush;
+
+        auto stats = get_stats(
+                it, std::chrono::duration<double, std::milli>(
+                        time_end - time_start).count(), current_units);
+        stats.searches = num_searches_ - num_searches;
+        stats.nodes_expanded = nodes_expanded_ - nodes_expanded;
+        stats.heap_pushes = heap_pushes_ - heap_pushes;
+        stats.routes_reused = routes_reused_ - routes_reused;
+        stats.corridor_misses = corridor_misses_ - corridor_misses;
+        if (coarse_router_)
+            stats.overused_channels = coarse_router_->get_overused_channels();
+        iteration_stats_.emplace_back(stats);
+        if (iteration_callback_)
+            iteration_callback_(iteration_stats_.back());
 
         if (!overflow()) {
+            // so that the timing reflects the final routes
+            if (timing_driven)
+                compute_criticality();
             return;
         }
 
@@ -82,6 +191,166 @@ void GlobalRouter::route() {
         throw ::runtime_error("unable to route. sorry!");
 }
 
+void GlobalRouter::route_units(const ::vector<const ::vector<int> *> &units,
+                               uint32_t it, ThreadPool &pool) {
+    // consecutive units whose search regions are at least one tile apart are
+    // routed concurrently as a batch. since a search never leaves the region
+    // of its unit and only looks one tile further, i.e. when checking for
+    // free switch boxes, units in a batch don't see each other's routes and
+    // the result is the same as routing them one by one within their
+    // regions. the batches only depend on the routing order, hence the
+    // result does not depend on the number of threads in the pool.
+    // the region also covers the current routes, which are ripped up in the
+    // parallel part.
+    // route patterns are recorded after every batch, so a net is not put in
+    // the same batch as another net of its class until the pattern of the
+    // class is known. it sees the same patterns as when routed one by one
+    auto const array = get_array_box();
+    ::vector<BoundingBox> regions;
+    regions.reserve(units.size());
+    for (auto const *unit : units) {
+        auto region = get_net_box(netlist_.at(unit->front()), bbox_margin,
+                                  array);
+        auto extend = [&region](uint32_t x, uint32_t y) {
+            region.xmin = std::min(region.xmin, x);
+            region.ymin = std::min(region.ymin, y);
+            region.xmax = std::max(region.xmax, x);
+            region.ymax = std::max(region.ymax, y);
+        };
+        for (auto const net_id : *unit) {
+            auto const box = get_net_box(netlist_.at(net_id), bbox_margin,
+                                         array);
+            extend(box.xmin, box.ymin);
+            extend(box.xmax, box.ymax);
+            auto iter = current_routes.find(net_id);
+            if (iter == current_routes.end())
+                continue;
+            for (auto const &[pin_id, segment] : iter->second) {
+                for (auto const &node : segment)
+                    extend(node->x, node->y);
+            }
+        }
+        regions.emplace_back(region);
+    }
+    auto apart = [](const BoundingBox &a, const BoundingBox &b) {
+        return a.xmax + 1 < b.xmin || b.xmax + 1 < a.xmin ||
+               a.ymax + 1 < b.ymin || b.ymax + 1 < a.ymin;
+    };
+
+    ::vector<char> failed;
+    ::vector<std::exception_ptr> errors;
+    uint32_t begin = 0;
+    while (begin < units.size()) {
+        auto end = begin + 1;
+        ::set<uint32_t> pending_classes;
+        auto pending_class = [this](const ::vector<int> *unit) {
+            return unit->size() == 1 ? pending_route_class(unit->front())
+                                     : std::nullopt;
+        };
+        if (auto const cls = pending_class(units[begin]))
+            pending_classes.emplace(*cls);
+        for (; end < units.size(); end++) {
+            bool independent = true;
+            for (auto i = begin; i < end && independent; i++)
+                independent = apart(regions[i], regions[end]);
+            auto const cls = pending_class(units[end]);
+            if (cls && !pending_classes.emplace(*cls).second)
+                independent = false;
+            if (!independent)
+                break;
+        }
+
+        // the maps shared by the nets are only modified outside of the
+        // parallel part
+        for (auto i = begin; i < end; i++) {
+            for (auto const net_id : *units[i])
+                current_routes.emplace(net_id, RouteSegments());
+        }
+        failed.assign(end - begin, false);
+        errors.assign(end - begin, nullptr);
+        pool.run(end - begin, [&](uint32_t index) {
+            auto const i = begin + index;
+            try {
+                for (auto const net_id : *units[i]) {
+                    rip_up_segments(net_id);
+                    route_net_timed(net_id, it, &regions[i]);
+                }
+            } catch (const UnableRouteException &) {
+                failed[index] = true;
+            } catch (...) {
+                errors[index] = std::current_exception();
+            }
+        });
+        for (auto const &error : errors) {
+            if (error)
+                std::rethrow_exception(error);
+        }
+
+        // units that can't be routed within their region are routed again
+        // without any limit, one by one
+        for (auto i = begin; i < end; i++) {
+            if (!failed[i - begin])
+                continue;
+            for (auto const net_id : *units[i]) {
+                reset_net(net_id);
+                route_net_timed(net_id, it);
+            }
+        }
+        for (auto i = begin; i < end; i++) {
+            for (auto const net_id : *units[i])
+                record_route_pattern(net_id);
+        }
+
+        begin = end;
+    }
+}
+
+void GlobalRouter::reset_net(int net_id) {
+    // route_net only fills in the segments of an existing entry, see
+    // route_units
+    current_routes.emplace(net_id, RouteSegments());
+    rip_up_segments(net_id);
+}
+
+void GlobalRouter::route_net_timed(int net_id, uint32_t it,
+                                   const BoundingBox *limit) {
+    auto const start = std::chrono::steady_clock::now();
+    route_net(net_id, it, limit);
+    auto const end = std::chrono::steady_clock::now();
+    net_durations_.find(net_id)->second +=
+            std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+IterationStats
+GlobalRouter::get_stats(uint32_t it, double duration,
+                        const ::vector<const ::vector<int> *> &units) const {
+    IterationStats stats;
+    stats.iteration = it;
+    stats.duration = duration;
+    stats.pn = init_pn_ * pow(pn_factor_, it);
+    stats.overused_nodes = static_cast<uint32_t>(get_overused_nodes().size());
+    stats.total_overuse = get_total_overuse();
+
+    ::vector<::pair<double, int>> durations;
+    for (auto const *unit : units) {
+        for (auto const net_id : *unit)
+            durations.emplace_back(net_durations_.at(net_id), net_id);
+    }
+    stats.nets_rerouted = static_cast<uint32_t>(durations.size());
+    auto const num_nets = std::min<uint64_t>(num_slowest_nets,
+                                             durations.size());
+    std::partial_sort(durations.begin(), durations.begin() + num_nets,
+                      durations.end(),
+                      [](const auto &a, const auto &b) {
+        return a.first > b.first || (a.first == b.first && a.second < b.second);
+    });
+    for (uint64_t i = 0; i < num_nets; i++) {
+        auto const &[time, net_id] = durations[i];
+        stats.slowest_nets.emplace_back(netlist_.at(net_id).name, time);
+    }
+    return stats;
+}
+
 void GlobalRouter::compute_slack_ratio(uint32_t current_iter) {
     // Note
     // this is slightly different from the PathFinder
@@ -100,6 +369,8 @@ void GlobalRouter::compute_slack_ratio(uint32_t current_iter) {
                 slack_ratio_[{net.id, seg_index}] = 1;
             }
         }
+    } else if (timing_driven) {
+        compute_criticality();
     } else {
         // Note:
         // Keyi:
@@ -124,7 +395,7 @@ void GlobalRouter::compute_slack_ratio(uint32_t current_iter) {
                 auto const &route = segments.at(net[seg_index].id);
                 double delay = 0;
                 for (const auto &node : route) {
-                    delay += node->delay;
+                    delay += node_delay_[node->id];
                 }
                 slack_ratio_[{net.id, seg_index}] = delay;
                 if (delay > max_delay)
@@ -147,11 +418,329 @@ void GlobalRouter::compute_slack_ratio(uint32_t current_iter) {
     }
 }
 
+void GlobalRouter::route_coarse(const ::vector<const ::vector<int> *> &units,
+                                uint32_t it) {
+    // the connections are routed in the same order as the detailed ones. the
+    // present congestion factor grows the same way as the detailed one
+    auto const pn = pow(pn_factor_, it);
+    ::vector<::pair<uint32_t, uint32_t>> pins;
+    for (auto const *unit : units) {
+        for (auto const net_id : *unit) {
+            auto &net = netlist_.at(net_id);
+            if (net.pin_order().size() + 1 != net.size())
+                net.set_pin_order(reorder_pins(net));
+            pins.clear();
+            pins.emplace_back(net[0].x, net[0].y);
+            for (auto const seg_index : net.pin_order())
+                pins.emplace_back(net[seg_index].x, net[seg_index].y);
+            coarse_router_->route_net(net_id, pins, pn);
+        }
+    }
+}
+
+void GlobalRouter::assign_coarse_history() {
+    auto const &g = *graph_;
+    ::vector<::pair<uint32_t, uint32_t>> tiles;
+    tiles.reserve(get_overused_nodes().size());
+    for (auto const node : get_overused_nodes())
+        tiles.emplace_back(g.x(node), g.y(node));
+    // the overused nodes are in no particular order
+    std::sort(tiles.begin(), tiles.end());
+    tiles.erase(std::unique(tiles.begin(), tiles.end()), tiles.end());
+    coarse_router_->assign_history(tiles);
+}
+
+void GlobalRouter::build_route_classes() {
+    net_route_classes_.clear();
+    route_patterns_.clear();
+    if (!reuse_routes)
+        return;
+    // nets are of the same kind if their pins have the same position relative
+    // to the src, on the same ports of tiles with the same signature. the
+    // pin order of a net only depends on the pin positions, so translated
+    // segments connect the same pins. reg nets are left out since their
+    // register locations are chosen while routing
+    using PinKey = std::tuple<int64_t, int64_t, uint32_t, ::string>;
+    ::map<::vector<PinKey>, ::vector<int>> classes;
+    auto const &g = *graph_;
+    for (auto const &[net_id, net] : netlist_) {
+        if (net.size() < 2)
+            continue;
+        auto const regs = needed_regs_.find(net_id);
+        if (regs != needed_regs_.end() && regs->second != 0)
+            continue;
+        ::vector<PinKey> key;
+        key.reserve(net.size());
+        bool valid = true;
+        for (auto const &pin : net) {
+            if (pin.name[0] == 'r' || !pin.node) {
+                valid = false;
+                break;
+            }
+            key.emplace_back(static_cast<int64_t>(pin.x) - net[0].x,
+                             static_cast<int64_t>(pin.y) - net[0].y,
+                             g.tile_signature(pin.x, pin.y), pin.port);
+        }
+        if (valid)
+            classes[key].emplace_back(net_id);
+    }
+    for (auto const &[key, net_ids] : classes) {
+        if (net_ids.size() < 2)
+            continue;
+        auto const cls = static_cast<uint32_t>(route_patterns_.size());
+        route_patterns_.emplace_back(std::nullopt);
+        for (auto const net_id : net_ids)
+            net_route_classes_.emplace(net_id, cls);
+    }
+}
+
+std::optional<uint32_t> GlobalRouter::pending_route_class(int net_id) const {
+    auto const iter = net_route_classes_.find(net_id);
+    if (iter == net_route_classes_.end() || route_patterns_[iter->second])
+        return std::nullopt;
+    return iter->second;
+}
+
+void GlobalRouter::record_route_pattern(int net_id) {
+    auto const cls = pending_route_class(net_id);
+    if (!cls)
+        return;
+    auto const &net = netlist_.at(net_id);
+    auto const &segments = current_routes.at(net_id);
+    RoutePattern pattern{net[0].x, net[0].y, {}};
+    for (auto const seg_index : net.pin_order()) {
+        auto const iter = segments.find(net[seg_index].id);
+        if (iter == segments.end())
+            return;
+        pattern.segments.emplace_back(seg_index,
+                                      graph_->get_ids(iter->second));
+    }
+    route_patterns_[*cls] = ::move(pattern);
+}
+
+bool GlobalRouter::reuse_route(int net_id, const BoundingBox *limit) {
+    auto const cls = net_route_classes_.find(net_id);
+    if (cls == net_route_classes_.end() || !route_patterns_[cls->second])
+        return false;
+    auto const &pattern = *route_patterns_[cls->second];
+    auto const &g = *graph_;
+    auto const &net = netlist_.at(net_id);
+    auto const dx = static_cast<int64_t>(net[0].x) - pattern.x;
+    auto const dy = static_cast<int64_t>(net[0].y) - pattern.y;
+
+    // every node has to exist, be free and stay within the limit, so that
+    // the concurrently routed nets are not affected
+    ::vector<::vector<uint32_t>> segments;
+    segments.reserve(pattern.segments.size());
+    for (auto const &[seg_index, ids] : pattern.segments) {
+        ::vector<uint32_t> segment;
+        segment.reserve(ids.size());
+        for (auto const id : ids) {
+            auto const node = g.translate(id, dx, dy);
+            if (node == CompiledGraph::INVALID_ID ||
+                (limit && !limit->contains(g.x(node), g.y(node))) ||
+                !node_owned_net(net_id, node) ||
+                (!segment.empty() && !g.has_edge(segment.back(), node)))
+                return false;
+            segment.emplace_back(node);
+        }
+        if (segment.empty() ||
+            segment.back() != g.get_id(net[seg_index].node))
+            return false;
+        segments.emplace_back(::move(segment));
+    }
+    if (segments.empty() || segments.front().front() != g.get_id(net[0].node))
+        return false;
+
+    auto &routes = current_routes.at(net_id);
+    for (uint64_t i = 0; i < segments.size(); i++) {
+        auto const seg_index = pattern.segments[i].first;
+        auto &segment = routes[net[seg_index].id];
+        segment = g.get_handles(segments[i]);
+        assign_net_segment(segment, net_id);
+    }
+    return true;
+}
+
+void GlobalRouter::set_timing_delays(::vector<uint64_t> delays) {
+    if (delays.size() != graph_->size())
+        throw ::runtime_error("timing delays don't match the routing graph");
+    timing_delays_ = ::move(delays);
+}
+
+void GlobalRouter::build_timing_graph() {
+    timing_connections_.clear();
+    timing_blocks_.clear();
+    timing_order_.clear();
+    net_timing_index_.clear();
+    timing_dirty_nets_.clear();
+
+    ::map<::string, uint32_t> block_ids;
+    auto get_block = [&](const Pin &pin) -> uint32_t {
+        auto const id = static_cast<uint32_t>(timing_blocks_.size());
+        auto const [iter, inserted] = block_ids.emplace(pin.name, id);
+        if (inserted) {
+            timing_blocks_.emplace_back();
+            timing_blocks_.back().combinational = pin.name[0] == 'p';
+        }
+        return iter->second;
+    };
+    for (auto const &[net_id, net] : netlist_) {
+        net_timing_index_.emplace(
+                net_id, static_cast<uint32_t>(timing_connections_.size()));
+        auto const src_block = get_block(net[0]);
+        for (uint32_t seg_index = 1; seg_index < net.size(); seg_index++) {
+            auto const sink_block = get_block(net[seg_index]);
+            auto const index =
+                    static_cast<uint32_t>(timing_connections_.size());
+            timing_connections_.push_back(
+                    {net_id, seg_index, src_block, sink_block});
+            timing_blocks_[src_block].outputs.emplace_back(index);
+            timing_blocks_[sink_block].inputs.emplace_back(index);
+        }
+        // nothing has been analyzed yet
+        timing_dirty_nets_.emplace(net_id);
+    }
+
+    // registered blocks start new timing paths, so only the edges into
+    // PE blocks are ordered. blocks on combinational loops, if any, are put
+    // at the end
+    ::vector<uint32_t> num_inputs(timing_blocks_.size(), 0);
+    for (auto const &conn : timing_connections_) {
+        if (timing_blocks_[conn.sink_block].combinational)
+            num_inputs[conn.sink_block]++;
+    }
+    for (uint32_t block = 0; block < timing_blocks_.size(); block++) {
+        if (num_inputs[block] == 0)
+            timing_order_.emplace_back(block);
+    }
+    for (uint64_t i = 0; i < timing_order_.size(); i++) {
+        for (auto const index : timing_blocks_[timing_order_[i]].outputs) {
+            auto const sink = timing_connections_[index].sink_block;
+            if (timing_blocks_[sink].combinational && --num_inputs[sink] == 0)
+                timing_order_.emplace_back(sink);
+        }
+    }
+    for (uint32_t block = 0; block < timing_blocks_.size(); block++) {
+        if (num_inputs[block] > 0)
+            timing_order_.emplace_back(block);
+    }
+}
+
+void GlobalRouter::update_connection_timing(int net_id) {
+    auto const &net = netlist_.at(net_id);
+    auto const &segments = current_routes.at(net_id);
+    auto const first = net_timing_index_.at(net_id);
+    auto node_delay = [this](const Node *node) -> uint64_t {
+        auto const id = graph_->get_id(node);
+        return timing_delays_.empty() ? node_delay_[id] : timing_delays_[id];
+    };
+
+    // segments start from a node that's either the src or on an earlier
+    // segment, so the route tree is walked in pin order. the src delay
+    // belongs to the upstream connections
+    struct Arrival {
+        uint64_t head = 0;
+        uint64_t tail = 0;
+        bool registered = false;
+    };
+    ::map<const Node *, Arrival> route_tree;
+    auto pin_order = net.pin_order();
+    if (pin_order.size() + 1 != net.size())
+        pin_order = reorder_pins(net);
+    for (auto const seg_index : pin_order) {
+        auto &conn = timing_connections_[first + seg_index - 1];
+        Arrival arrival;
+        auto const iter = segments.find(net[seg_index].id);
+        if (iter != segments.end() && !iter->second.empty()) {
+            auto const &segment = iter->second;
+            auto const branch = route_tree.find(segment.front());
+            if (branch != route_tree.end())
+                arrival = branch->second;
+            for (uint32_t i = 1; i < segment.size(); i++) {
+                auto const *node = segment[i];
+                if (node->type == NodeType::Register &&
+                    i != segment.size() - 1) {
+                    // pipeline register
+                    arrival.registered = true;
+                    arrival.tail = 0;
+                } else if (arrival.registered) {
+                    arrival.tail += node_delay(node);
+                } else {
+                    arrival.head += node_delay(node);
+                }
+                route_tree.emplace(node, arrival);
+            }
+        }
+        conn.head = arrival.head;
+        conn.tail = arrival.tail;
+        conn.registered = arrival.registered;
+    }
+}
+
+void GlobalRouter::compute_criticality() {
+    for (auto const net_id : timing_dirty_nets_)
+        update_connection_timing(net_id);
+    timing_dirty_nets_.clear();
+
+    // arrival time at the block outputs and the longest delay from the
+    // block outputs to a timing endpoint, i.e. a registered block or a
+    // pipeline register
+    auto const num_blocks = timing_blocks_.size();
+    ::vector<uint64_t> arrival(num_blocks, 0);
+    ::vector<uint64_t> downstream(num_blocks, 0);
+    auto sink_downstream = [&](const TimingConnection &conn) -> uint64_t {
+        return timing_blocks_[conn.sink_block].combinational ?
+               downstream[conn.sink_block] : 0;
+    };
+    for (auto const block : timing_order_) {
+        if (!timing_blocks_[block].combinational)
+            continue;
+        for (auto const index : timing_blocks_[block].inputs) {
+            auto const &conn = timing_connections_[index];
+            auto const time = conn.registered ?
+                              conn.tail :
+                              arrival[conn.src_block] + conn.head;
+            arrival[block] = std::max(arrival[block], time);
+        }
+    }
+    for (auto iter = timing_order_.rbegin(); iter != timing_order_.rend();
+         iter++) {
+        auto const block = *iter;
+        for (auto const index : timing_blocks_[block].outputs) {
+            auto const &conn = timing_connections_[index];
+            auto const time = conn.registered ?
+                              conn.head :
+                              conn.head + sink_downstream(conn);
+            downstream[block] = std::max(downstream[block], time);
+        }
+    }
+
+    // the criticality of a connection is the delay of the longest path
+    // through it over the critical path delay, i.e. 1 - slack / delay
+    ::vector<uint64_t> path_delays(timing_connections_.size());
+    critical_path_delay_ = 0;
+    for (uint64_t i = 0; i < timing_connections_.size(); i++) {
+        auto const &conn = timing_connections_[i];
+        auto const start = arrival[conn.src_block] + conn.head;
+        auto const end = sink_downstream(conn);
+        path_delays[i] = conn.registered ?
+                         std::max(start, conn.tail + end) : start + end;
+        critical_path_delay_ = std::max(critical_path_delay_, path_delays[i]);
+    }
+    for (uint64_t i = 0; i < timing_connections_.size(); i++) {
+        auto const &conn = timing_connections_[i];
+        slack_ratio_[{conn.net_id, conn.seg_index}] =
+                critical_path_delay_ == 0 ?
+                1 : static_cast<double>(path_delays[i]) / critical_path_delay_;
+    }
+}
+
 void GlobalRouter::add_regs_post_route(int net_id, Pin &pin, int req_regs) {
     if (req_regs == 0) 
         return;
 
-    auto segment = current_routes[net_id][pin.id];
+    auto segment = current_routes.at(net_id).at(pin.id);
 
     ::vector<int> avail_reg_idx;
 
@@ -180,7 +769,7 @@ void GlobalRouter::add_regs_post_route(int net_id, Pin &pin, int req_regs) {
         auto head = segment[avail_reg_idx[idx] + i];
         for (auto const &node : *head) {
             if (node.lock()->type == NodeType::Register) {
-                segment.insert(segment.begin() + avail_reg_idx[idx] + 1 + i, node.lock());
+                segment.insert(segment.begin() + avail_reg_idx[idx] + 1 + i, node.lock().get());
                 added_reg = true;
             }
         }
@@ -188,20 +777,32 @@ void GlobalRouter::add_regs_post_route(int net_id, Pin &pin, int req_regs) {
             throw ::runtime_error("unable to add reg to segment post route");
     }
 
-    current_routes[net_id][pin.id] = segment;
+    current_routes.at(net_id)[pin.id] = segment;
 
 }
 
 void
-GlobalRouter::route_net(int net_id, uint32_t it) {
-
-
-    ::vector<::shared_ptr<Node>> current_path;
-    auto pin_indices = reorder_pins(netlist_[net_id]);
+GlobalRouter::route_net(int net_id, uint32_t it, const BoundingBox *limit) {
+    if (reuse_route(net_id, limit)) {
+        routes_reused_++;
+        return;
+    }
+    auto const &g = *graph_;
+    auto const area = limit ? *limit : get_array_box();
+
+    // nodes on the route tree and their search cost from the src
+    ::vector<::pair<uint32_t, double>> route_tree;
+    ::vector<::pair<uint32_t, double>> seeds;
+    // the pin order only depends on the pin locations, hence it's computed
+    // once and cached on the net
+    auto &routed_net = netlist_.at(net_id);
+    if (routed_net.pin_order().size() + 1 != routed_net.size())
+        routed_net.set_pin_order(reorder_pins(routed_net));
+    auto const &pin_indices = routed_net.pin_order();
     for (uint32_t pin_index = 0; pin_index < pin_indices.size(); pin_index++) {
         // we may update the src while routing, i.e. for reg nets, so we pull
         // the src info for every pins
-        auto &net = netlist_[net_id];
+        auto &net = netlist_.at(net_id);
         const auto &src = net[0].node;
         if (src == nullptr)
             throw ::runtime_error("unable to find src when route net");
@@ -210,68 +811,73 @@ GlobalRouter::route_net(int net_id, uint32_t it) {
         auto const &sink_node = net[seg_index];
 
         auto slack_entry = make_pair(src, sink_node.name);
-        auto sink_coord = std::make_pair(sink_node.x, sink_node.y);
         double slack = slack_ratio_.at({net.id, seg_index});
         RoutingStrategy strategy = slack > route_strategy_ratio ?
                                    RoutingStrategy::DelayDriven :
                                    RoutingStrategy::CongestionDriven;
 
-        ::shared_ptr<Node> src_node = src;
-        // choose src_node
-        if (strategy == RoutingStrategy::CongestionDriven
-            && !current_path.empty()) {
-            // find the closest point
-            uint32_t min_dist = manhattan_distance(src_node, sink_coord);
-            for (uint32_t p = 1; p < current_path.size(); p++) {
-                const auto &node = current_path[p];
-                // const auto &pre_node = current_path[p - 1];
-                const auto &conn = node_connections_.at(node);
+        auto an = slack * slack_factor_;
+        auto cost_f = create_congestion_cost(an, it, net.id);
+
+        // seed the search with the route tree so that the sink is connected
+        // to whichever branch point is the cheapest. every branch point
+        // starts with the cost the search had when it reached the node, so
+        // the seeds are on the same scale as the costs of the search
+        seeds.clear();
+        uint32_t src_node = g.get_id(src);
+        seeds.emplace_back(src_node, 0);
+        if (strategy == RoutingStrategy::CongestionDriven) {
+            for (auto const &[node, cost] : route_tree) {
                 // break them into several parts so that it's easier to
                 // read and modify
-                if (node->type != NodeType::SwitchBox) {
+                if (node == src_node || g.type(node) != NodeType::SwitchBox) {
                     // it has to be a switch box
                     continue;
                 }
                 // has to be an in switch box so that we can switch tracks
-                auto sb = std::dynamic_pointer_cast<SwitchBoxNode>(node);
-                if (sb->io == SwitchBoxIO::SB_OUT)
+                if (g.io(node) == SwitchBoxIO::SB_OUT)
                     continue;
                 // it can't be overflowed already
-                if (conn.size() > 1) {
-                    continue;
-                }
-
-                // it has at least one free switch box connections
-                bool empty = false;
-                for (auto const &n : *node) {
-                    if (node_connections_.at(n.lock()).empty()) {
-                        empty = true;
-                        break;
-                    }
-                    if (node_connections_.at(n.lock()).size() == 1
-                        && *node_connections_.at(n.lock()).begin() == node
-                        && (node_net_ids_.at(n.lock()).empty()
-                            || node_owned_net(net.id, n.lock()))) {
-                        empty = true;
-                        break;
-                    }
-                }
-                if (!empty)
+                if (node_connections_[node].size() > 1)
                     continue;
-
-                if (manhattan_distance(node, sink_coord) < min_dist) {
-                    src_node = node;
-                    min_dist = manhattan_distance(node, sink_coord);
-                }
+                seeds.emplace_back(node, cost);
             }
         }
-        auto an = slack * slack_factor_;
-        auto cost_f = create_cost_function(an, it, net.id);
-        int req_regs = needed_regs_[net_id];
+        int req_regs = needed_regs_.at(net_id);
         if (net[0].name[0] == 'r' && pin_index == 0) {
             req_regs++;
         }
 
+        // search within the corridor of the connection, if any, then within
+        // the bounding box and only grow it when the sink is not reachable.
+        // the last try is on the whole limit
+        auto route_in_box = [&](const auto &end_f, const auto &h_f) {
+            if (coarse_router_) {
+                auto const corridor = coarse_router_->get_corridor(
+                        net.id, pin_index + 1, corridor_margin);
+                try {
+                    return route_a_star(seeds, end_f, cost_f, h_f, req_regs,
+                                        limit, &corridor);
+                } catch (UnableRouteException &) {
+                    corridor_misses_++;
+                }
+            }
+            auto margin = bbox_margin;
+            while (true) {
+                auto box = get_net_box(net, margin, area);
+                bool const last = box.contains(area);
+                try {
+                    return route_a_star(seeds, end_f, cost_f, h_f, req_regs,
+                                        last && !limit ? nullptr : &box);
+                } catch (UnableRouteException &) {
+                    if (last)
+                        throw;
+                }
+                margin = std::max(margin + 1, static_cast<uint32_t>(
+                        std::ceil(margin * bbox_growth)));
+            }
+        };
+
         // find the routes
         if (sink_node.name[0] == 'r') {
             ::pair<uint32_t, uint32_t> end = {sink_node.x, sink_node.y};
@@ -280,15 +886,15 @@ GlobalRouter::route_net(int net_id, uint32_t it) {
             }
 
             // for now just find the switch in and decides the register later
-            auto end_f = get_free_switch(end);
-            auto h_f = manhattan_distance(end);
-            auto segment = route_a_star(src_node, end_f, cost_f, h_f, req_regs);
+            FreeSwitch end_f{this, end};
+            auto h_f = get_heuristic(end, NodeType::SwitchBox);
+            auto segment = g.get_handles(route_in_box(end_f, h_f));
 
             if (segment.back()->type != NodeType::SwitchBox) {
                 throw ::runtime_error("cannot connect to the reg tile");
             }
 
-            auto switch_node = segment.back();
+            auto const &switch_node = g.get_node(g.get_id(segment.back()));
             // make sure it's an reg node
             if (switch_node == nullptr)
                 throw ::runtime_error("unable to route for net id " + net.name);
@@ -300,15 +906,18 @@ GlobalRouter::route_net(int net_id, uint32_t it) {
 
             // assign pins to the downstream
             int reg_net_id = reg_net_src_.at(sink_node.name);
-            netlist_[reg_net_id][0].node = switch_node;
+            netlist_.at(reg_net_id)[0].node = switch_node;
 
             // store the segment
-            current_routes[net.id][sink_node.id] = segment;
+            current_routes.at(net.id)[sink_node.id] = segment;
 
 
             // add some metadata information so that we can fix the reg net very
             // quickly later
-            reg_net_table_.insert({reg_net_id, {net.id, sink_node.id}});
+            {
+                std::lock_guard<std::mutex> guard(reg_net_mutex_);
+                reg_net_table_.insert({reg_net_id, {net.id, sink_node.id}});
+            }
 
         } else {
 
@@ -316,13 +925,16 @@ GlobalRouter::route_net(int net_id, uint32_t it) {
                 throw ::runtime_error("unable to find node for block"
                                       " " + sink_node.name);
 
-            auto segment = route_a_star(src_node, sink_node.node, cost_f, req_regs);
-            if (segment.back() != sink_node.node) {
+            auto end = g.get_id(sink_node.node);
+            SameNode end_f{end};
+            auto h_f = get_heuristic(end);
+            auto segment = g.get_handles(route_in_box(end_f, h_f));
+            if (segment.back() != sink_node.node.get()) {
                 throw ::runtime_error("unable to route to port " +
                                       sink_node.node->name);
             }
 
-            current_routes[net.id][sink_node.id] = segment;
+            current_routes.at(net.id)[sink_node.id] = segment;
         }
 
         // fix the reg net
@@ -334,107 +946,136 @@ GlobalRouter::route_net(int net_id, uint32_t it) {
                 fix_register_net(net.id, net[seg_index]);
             }
         }
-        add_regs_post_route(net.id, net[seg_index], needed_regs_[net.id]);
-
-        // also put segment into the current path
-        const auto &segment = current_routes[net.id][sink_node.id];
-
-
-        current_path.insert(current_path.end(), segment.begin(), segment.end());
+        add_regs_post_route(net.id, net[seg_index], needed_regs_.at(net.id));
+
+        // also put segment into the route tree. it starts from a node that's
+        // either the src or already on the tree
+        // the cost of every node is accumulated with the cost function of
+        // the connection, before the segment is assigned, as in the search
+        const auto &segment = current_routes.at(net.id).at(sink_node.id);
+        double cost = 0;
+        auto const branch = g.get_id(segment.front());
+        for (auto const &[node, node_cost] : route_tree) {
+            if (node == branch) {
+                cost = node_cost;
+                break;
+            }
+        }
+        for (uint32_t i = 1; i < segment.size(); i++) {
+            auto const pre_node = g.get_id(segment[i - 1]);
+            auto const node = g.get_id(segment[i]);
+            for (auto const &edge : g.edges(pre_node)) {
+                if (edge.node == node) {
+                    cost += cost_f(pre_node, edge);
+                    break;
+                }
+            }
+            route_tree.emplace_back(node, cost);
+        }
         // assign it to the node_connections
         assign_net_segment(segment, net.id);
     }
 }
 
-::function<double(const ::shared_ptr<Node> &, const ::shared_ptr<Node> &)>
+BoundingBox GlobalRouter::get_array_box() const {
+    auto const &g = *graph_;
+    return {0, 0, g.width() > 0 ? g.width() - 1 : 0,
+            g.height() > 0 ? g.height() - 1 : 0};
+}
+
+BoundingBox GlobalRouter::get_net_box(const Net &net, uint32_t margin,
+                                      const BoundingBox &area) const {
+    // the src may be moved while routing reg nets, so its node position is
+    // used when available
+    BoundingBox box{net[0].x, net[0].y, net[0].x, net[0].y};
+    auto extend = [&box](uint32_t x, uint32_t y) {
+        box.xmin = std::min(box.xmin, x);
+        box.ymin = std::min(box.ymin, y);
+        box.xmax = std::max(box.xmax, x);
+        box.ymax = std::max(box.ymax, y);
+    };
+    if (net[0].node)
+        extend(net[0].node->x, net[0].node->y);
+    for (uint32_t i = 1; i < net.size(); i++)
+        extend(net[i].x, net[i].y);
+
+    // clamp it to the area
+    box.xmin = box.xmin > area.xmin + margin ? box.xmin - margin : area.xmin;
+    box.ymin = box.ymin > area.ymin + margin ? box.ymin - margin : area.ymin;
+    box.xmax = area.xmax > box.xmax + margin ? box.xmax + margin : area.xmax;
+    box.ymax = area.ymax > box.ymax + margin ? box.ymax + margin : area.ymax;
+    return box;
+}
+
+GlobalRouter::CongestionCost
+GlobalRouter::create_congestion_cost(double an, uint32_t it,
+                                     int net_id) const {
+    return {this, an, init_pn_ * pow(pn_factor_, it), hn_factor_, net_id};
+}
+
+::function<double(uint32_t, const CompiledGraph::Edge &)>
 GlobalRouter::create_cost_function(double an,
                                    uint32_t it,
                                    int net_id) {
-    return [&, an, it, net_id](const ::shared_ptr<Node> &node1,
-               const ::shared_ptr<Node> &node2) -> double {
-        // based of the PathFinder paper
-        auto pn = get_presence_cost(node2, node1);
-        /* Note:
-         * this is a new entry compared to PathFiner paper since we need to
-         * prevent registers's switchbox been used for other nets.
-         */
-        if (!node_owned_net(net_id, node2)) {
-            pn += 1;
-        }
-        auto pn_factor = init_pn_ * pow(pn_factor_, it);
-        pn *= pn_factor;
-        auto dn = node1->get_edge_cost(node2);
-        auto hn = get_history_cost(node2) * hn_factor_;
-
-        auto result = an * dn + (1 - an) * (dn + hn) * pn;
-        return result;
-    };
+    return create_congestion_cost(an, it, net_id);
 }
 
 GlobalRouter::GlobalRouter(uint32_t num_iteration, const RoutingGraph &g) :
     Router(g), num_iteration_(num_iteration), slack_ratio_()  {}
 
-std::function<bool(const std::shared_ptr<Node> &)>
-GlobalRouter::get_free_switch(const std::pair<uint32_t, uint32_t> &p) {
-    return [&, p](const std::shared_ptr<Node> &node) -> bool {
-        if (node == nullptr || node->type != NodeType::SwitchBox
-            || node->x != p.first || node->y != p.second) {
-            return false;
-        }
-        else {
-            // see it's been used or not
-            if (!node_connections_.at(node).empty())
-                return false;
+GlobalRouter::GlobalRouter(uint32_t num_iteration,
+                           std::shared_ptr<const CompiledGraph> graph) :
+    Router(std::move(graph)), num_iteration_(num_iteration), slack_ratio_() {}
 
-            // two hope check to see if there is any register nodes
-            ::set<std::shared_ptr<Node>> first_hop;
-            for (auto const &n : *node) {
-                if (n.lock()->type == NodeType::Register)
-                    return true;
-                first_hop.insert(n.lock());
-            }
-            for (auto const &n : first_hop) {
-                for (auto const &nn : *n) {
-                    if (nn.lock()->type == NodeType::Register)
-                        return true;
-                }
-            }
+bool GlobalRouter::is_free_switch(uint32_t node) const {
+    auto const &g = *graph_;
+    // it has to be able to reach a register within two hops, which is
+    // precomputed by the graph, and not been used yet
+    return g.near_register(node) && node_connections_[node].empty();
+}
 
-            return false;
-        }
-    };
+std::function<bool(uint32_t)>
+GlobalRouter::get_free_switch(const std::pair<uint32_t, uint32_t> &p) {
+    return FreeSwitch{this, p};
 }
 
 std::vector<uint32_t> GlobalRouter::reorder_pins(const Net &net) {
-    ::vector<uint32_t> result(net.size() - 1);
-    for (uint32_t i = 0; i < result.size(); i++)
-        result[i] = i + 1;
-
-    ::vector<uint32_t> finished_list = {0u};
-    // the sorting is similar to RSMT tree construction
-    for (uint32_t i = 0; i < result.size() - 1; i++) {
-        std::stable_sort(result.begin() + i,
-                         result.end(),
-                         [&](uint32_t a, uint32_t b) -> bool {
-                             uint32_t dist_a = 0;
-                             uint32_t dist_b = 0;
-                             for (auto const &index : finished_list) {
-                                 const auto pos = std::make_pair(net[index].x,
-                                                                 net[index].y);
-                                 dist_a += manhattan_distance({net[a].x,
-                                                               net[a].y}, pos);
-                                 dist_b += manhattan_distance({net[b].x,
-                                                               net[b].y}, pos);
-                             }
-                             return dist_a < dist_b;
-                         });
+    // Prim's algorithm on the manhattan distance, starting from the src.
+    // every sink is visited after the closest one to the tree so far, which
+    // is similar to RSMT tree construction. ties go to the lower index
+    ::vector<uint32_t> result;
+    if (net.size() < 2)
+        return result;
+    result.reserve(net.size() - 1);
+    ::vector<uint32_t> dist(net.size());
+    ::vector<bool> finished(net.size(), false);
+    finished[0] = true;
+    for (uint32_t i = 1; i < net.size(); i++)
+        dist[i] = manhattan_distance({net[i].x, net[i].y},
+                                     {net[0].x, net[0].y});
+
+    while (result.size() + 1 < net.size()) {
+        uint32_t next = 0;
+        for (uint32_t i = 1; i < net.size(); i++) {
+            if (!finished[i] && (next == 0 || dist[i] < dist[next]))
+                next = i;
+        }
+        finished[next] = true;
+        result.emplace_back(next);
+        for (uint32_t i = 1; i < net.size(); i++) {
+            if (finished[i])
+                continue;
+            dist[i] = std::min(dist[i],
+                               manhattan_distance({net[i].x, net[i].y},
+                                                  {net[next].x, net[next].y}));
+        }
     }
 
     return result;
 }
 
 void GlobalRouter::fix_register_net(int net_id, Pin &pin) {
-    auto segment = current_routes[net_id][pin.id];
+    auto segment = current_routes.at(net_id).at(pin.id);
     auto src_node = segment[0];
     if (src_node->type != NodeType::SwitchBox)
         throw ::runtime_error("the beginning of a reg fix has to be a sb");
@@ -444,16 +1085,16 @@ void GlobalRouter::fix_register_net(int net_id, Pin &pin) {
      * it is safe to assume that the registers are pipeline registers
      * that points to the same node
      */
-    ::shared_ptr<Node> reg_node = nullptr;
-    ::shared_ptr<Node> pre_node = nullptr;
+    NodeHandle reg_node = nullptr;
+    NodeHandle pre_node = nullptr;
     for (const auto &node : segment) {
         for (const auto &next : *node) {
             if (next.lock()->type == NodeType::Register) {
-                if (!node_connections_.at(next.lock()).empty()) {
+                if (!node_connections_[next.lock()->id].empty()) {
                     continue;
                 } else {
                     pre_node = node;
-                    reg_node = next.lock();
+                    reg_node = next.lock().get();
                     break;
                 }
             }
@@ -473,7 +1114,7 @@ void GlobalRouter::fix_register_net(int net_id, Pin &pin) {
     auto index = segment.size();
     for (auto const &next_node : *reg_node) {
         for (index = 0; index < segment.size(); index++) {
-            if (segment[index] == next_node.lock()) {
+            if (segment[index] == next_node.lock().get()) {
                 break;
             }
         }
@@ -487,18 +1128,23 @@ void GlobalRouter::fix_register_net(int net_id, Pin &pin) {
         throw ::runtime_error("unable to find the connected register in given "
                               "path");
     // do a surgery to fix the path
-    ::vector<::shared_ptr<Node>> new_segment = {reg_node};
+    ::vector<NodeHandle> new_segment = {reg_node};
     for (auto i = index; i < segment.size(); i++) {
         // append to the new segment
         new_segment.emplace_back(segment[i]);
     }
 
-    netlist_[net_id][0].node = reg_node;
+    auto const &reg = graph_->get_node(graph_->get_id(reg_node));
+    netlist_.at(net_id)[0].node = reg;
     // update the current_routes
-    current_routes[net_id][pin.id] = new_segment;
+    current_routes.at(net_id)[pin.id] = new_segment;
 
     // and we need to fix the old segment by appending to the new ones
-    auto key_entry = reg_net_table_.at(net_id);
+    ::pair<int, uint32_t> key_entry;
+    {
+        std::lock_guard<std::mutex> guard(reg_net_mutex_);
+        key_entry = reg_net_table_.at(net_id);
+    }
     auto &src_segment = current_routes.at(key_entry.first).at(key_entry.second);
     auto fix_index = src_segment.size();
     if (src_segment.back() != segment.front())
@@ -514,13 +1160,13 @@ void GlobalRouter::fix_register_net(int net_id, Pin &pin) {
     src_segment.emplace_back(reg_node);
     // update with the node assignment for the new one and finally we're done
     for (auto i = fix_index; i < src_segment.size(); i++) {
-        assign_connection(src_segment[i], src_segment[i - 1]);
+        assign_connection(src_segment[i]->id, src_segment[i - 1]->id);
     }
     // this will be the new segment
     // then assign the new pin node
     auto &reg_sink_pin = netlist_.at(static_cast<uint32_t>
                                      (key_entry.first))[key_entry.second];
-    reg_sink_pin.node = reg_node;
+    reg_sink_pin.node = reg;
     if (reg_sink_pin.name[0] != 'r')
         throw ::runtime_error("assigning registers to a wrong pin");
 }
@@ -1,28 +1,180 @@
 #ifndef CYCLONE_GLOBAL_HH
 #define CYCLONE_GLOBAL_HH
 
+#include <mutex>
+#include "coarse.hh"
 #include "route.hh"
 
+class ThreadPool;
+
+// statistics of a routing iteration, see GlobalRouter::set_iteration_callback
+struct IterationStats {
+    uint32_t iteration = 0;
+    // in ms
+    double duration = 0;
+    // nodes with more than one driver, and the sum of their extra drivers,
+    // at the end of the iteration
+    uint32_t overused_nodes = 0;
+    uint32_t total_overuse = 0;
+    uint32_t nets_rerouted = 0;
+    // search counters of this iteration. a net takes one search per sink,
+    // plus one for every time its bounding box grows
+    uint64_t searches = 0;
+    uint64_t nodes_expanded = 0;
+    uint64_t heap_pushes = 0;
+    // nets routed by translating the route of an identical net instead of
+    // searching
+    uint32_t routes_reused = 0;
+    // with two-level routing, the channels of the coarse grid used by more
+    // nets than their capacity, and the searches that had to leave the
+    // corridor of their connection
+    uint32_t overused_channels = 0;
+    uint64_t corridor_misses = 0;
+    // present congestion factor of this iteration
+    double pn = 0;
+    // the slowest nets in this iteration and their routing time in ms
+    std::vector<std::pair<std::string, double>> slowest_nets;
+};
+
 class GlobalRouter : public Router {
 public:
     GlobalRouter(uint32_t num_iteration, const RoutingGraph &g);
+    GlobalRouter(uint32_t num_iteration,
+                 std::shared_ptr<const CompiledGraph> graph);
 
     void route() override;
 
     double route_strategy_ratio = 1;
+    // searches are limited to the pin bounding box of the net extended by
+    // bbox_margin tiles. if a sink can't be reached, the margin is scaled by
+    // bbox_growth until the box covers the whole array
+    uint32_t bbox_margin = 3;
+    double bbox_growth = 2;
+    // after the first iteration, only reroute the nets that use overflowed
+    // nodes instead of all of them
+    bool incremental_reroute = true;
+    // nets far enough from each other are routed concurrently when it's
+    // larger than 1. each search is then limited to the region of its net,
+    // and only the nets that can't be routed within it search the whole
+    // array afterwards. the routes are deterministic for a given number of
+    // threads, and the same for any number larger than 1
+    uint32_t num_threads = 1;
+    // number of nets reported in IterationStats::slowest_nets
+    uint32_t num_slowest_nets = 5;
+    // when set, the criticality of every connection comes from a static
+    // timing analysis over the current routes instead of the normalized
+    // route delay. only the nets rerouted in the last iteration are walked
+    // again, the arrival times are then propagated over the whole netlist
+    bool timing_driven = false;
+    // nets whose pins are the same up to a translation, e.g. the ones of
+    // replicated kernels, first try the translated route of the first routed
+    // net of their kind. A* is only run if the route can't be translated or
+    // conflicts with other nets. reg nets always search
+    bool reuse_routes = true;
+    // two-level routing: the nets are routed on a tile-level channel graph
+    // first, see CoarseRouter, and the detailed search of every connection is
+    // limited to the tiles of its coarse route widened by corridor_margin
+    // tiles. if the sink can't be reached within the corridor, the search
+    // falls back to the bounding box. the congested tiles of the detailed
+    // routes are fed back to the coarse costs after every iteration
+    bool two_level = false;
+    uint32_t corridor_margin = 1;
+
+    // per-node delays used by the timing analysis, indexed by node id. see
+    // get_node_timing_delays(). the node delays are used if not set
+    void set_timing_delays(std::vector<uint64_t> delays);
+    // critical path delay found by the last timing analysis
+    uint64_t get_critical_path_delay() const { return critical_path_delay_; }
+    // criticality of the connection to the sink of the net, i.e. the ratio
+    // used by the cost function
+    double get_criticality(int net_id, uint32_t seg_index) const
+    { return slack_ratio_.at({net_id, seg_index}); }
+
+    // the callback is run at the end of every iteration, on the thread that
+    // called route()
+    void set_iteration_callback(
+            std::function<void(const IterationStats &)> callback)
+    { iteration_callback_ = std::move(callback); }
+    // statistics of every iteration of the last route()
+    const std::vector<IterationStats> &get_iteration_stats() const
+    { return iteration_stats_; }
 
 protected:
+    // the searches are limited to the given region if set. otherwise they can
+    // grow to the whole array
     virtual void
-    route_net(int net_id, uint32_t it);
+    route_net(int net_id, uint32_t it, const BoundingBox *limit = nullptr);
 
     virtual void compute_slack_ratio(uint32_t current_iter);
-    virtual std::function<double(const std::shared_ptr<Node> &,
-                                 const std::shared_ptr<Node> &)>
+
+    // search policies used by route_net
+    // cost: based on the PathFinder paper. the iteration-dependent factor is
+    // computed once per net rather than on every edge
+    struct CongestionCost {
+        const GlobalRouter *router;
+        double an;
+        double pn_factor;
+        double hn_factor;
+        int net_id;
+
+        double operator()(uint32_t id1,
+                           const CompiledGraph::Edge &edge) const {
+            auto const id2 = edge.node;
+            auto pn = router->get_presence_cost(id2, id1);
+            /* Note:
+             * this is a new entry compared to PathFiner paper since we need
+             * to prevent registers's switchbox been used for other nets.
+             */
+            if (!router->node_owned_net(net_id, id2)) {
+                pn += 1;
+            }
+            pn *= pn_factor;
+            double dn = edge.cost;
+            auto hn = router->get_history_cost(id2) * hn_factor;
+
+            return an * dn + (1 - an) * (dn + hn) * pn;
+        }
+    };
+    // goal: an unused switch box at the given location that can reach a
+    // register within two hops
+    struct FreeSwitch {
+        const GlobalRouter *router;
+        std::pair<uint32_t, uint32_t> pos;
+
+        bool operator()(uint32_t node) const {
+            auto const &g = *router->graph_;
+            if (g.type(node) != NodeType::SwitchBox
+                || g.x(node) != pos.first || g.y(node) != pos.second)
+                return false;
+            return router->is_free_switch(node);
+        }
+    };
+
+    CongestionCost create_congestion_cost(double an, uint32_t it,
+                                          int net_id) const;
+    bool is_free_switch(uint32_t node) const;
+
+    // type-erased versions of the policies above
+    virtual std::function<double(uint32_t, const CompiledGraph::Edge &)>
     create_cost_function(double an, uint32_t it, int net_id);
 
-    virtual std::function<bool(const std::shared_ptr<Node> &)>
+    virtual std::function<bool(uint32_t)>
     get_free_switch(const std::pair<uint32_t, uint32_t> &p);
 
+    // timing analysis, see timing_driven. the graph is built once per route()
+    // and the criticality is computed over the current routes
+    void build_timing_graph();
+    void update_connection_timing(int net_id);
+    void compute_criticality();
+
+    // route reuse, see reuse_routes. the classes are built once per route()
+    void build_route_classes();
+    // class of the net if its pattern is yet to be recorded
+    std::optional<uint32_t> pending_route_class(int net_id) const;
+    void record_route_pattern(int net_id);
+    // assigns the translated pattern of the class if every node is free
+    bool reuse_route(int net_id, const BoundingBox *limit);
+
 private:
     uint32_t num_iteration_ = 40;
 
@@ -30,9 +182,77 @@ private:
              double> slack_ratio_;
     double hn_factor_ = 0.1;
     double slack_factor_ = 0.9;
+    using RouteSegments = std::map<uint32_t, std::vector<NodeHandle>>;
     std::map<int, std::pair<int, uint32_t>> reg_net_table_;
+    std::mutex reg_net_mutex_;
+
+    std::function<void(const IterationStats &)> iteration_callback_;
+    std::vector<IterationStats> iteration_stats_;
+    // routing time of the nets in the current iteration. the entries are
+    // created before routing so that they can be updated concurrently
+    std::map<int, double> net_durations_;
+
+    // timing graph of the netlist. blocks are identified by the pin name,
+    // and only PE blocks are combinational
+    struct TimingConnection {
+        int net_id;
+        uint32_t seg_index;
+        uint32_t src_block;
+        uint32_t sink_block;
+        // delay from the src to the first register on the route, or to the
+        // sink if there isn't any, and from the last register to the sink
+        uint64_t head = 0;
+        uint64_t tail = 0;
+        bool registered = false;
+    };
+    struct TimingBlock {
+        bool combinational = false;
+        std::vector<uint32_t> inputs;
+        std::vector<uint32_t> outputs;
+    };
+    std::vector<TimingConnection> timing_connections_;
+    std::vector<TimingBlock> timing_blocks_;
+    // blocks in topological order, ignoring the edges into registered blocks
+    std::vector<uint32_t> timing_order_;
+    // index of the first connection of every net
+    std::map<int, uint32_t> net_timing_index_;
+    // nets whose routes changed since the last timing analysis
+    std::set<int> timing_dirty_nets_;
+    std::vector<uint64_t> timing_delays_;
+    uint64_t critical_path_delay_ = 0;
+
+    // routes of the first routed net of every translation class, in pin
+    // order and relative to the src tile
+    struct RoutePattern {
+        uint32_t x;
+        uint32_t y;
+        std::vector<std::pair<uint32_t, std::vector<uint32_t>>> segments;
+    };
+    // class of the nets that have others of the same kind
+    std::map<int, uint32_t> net_route_classes_;
+    std::vector<std::optional<RoutePattern>> route_patterns_;
+    std::atomic<uint32_t> routes_reused_ = 0;
+
+    std::unique_ptr<CoarseRouter> coarse_router_;
+    std::atomic<uint64_t> corridor_misses_ = 0;
+
+    void route_coarse(const std::vector<const std::vector<int> *> &units,
+                      uint32_t it);
+    void assign_coarse_history();
 
     std::vector<uint32_t> reorder_pins(const Net &net);
+    BoundingBox get_array_box() const;
+    // pin bounding box of the net extended by margin, within area
+    BoundingBox get_net_box(const Net &net, uint32_t margin,
+                            const BoundingBox &area) const;
+    void route_units(const std::vector<const std::vector<int> *> &units,
+                     uint32_t it, ThreadPool &pool);
+    void reset_net(int net_id);
+    void route_net_timed(int net_id, uint32_t it,
+                         const BoundingBox *limit = nullptr);
+    IterationStats get_stats(uint32_t it, double duration,
+                             const std::vector<const std::vector<int> *> &units)
+                             const;
     void fix_register_net(int net_id, Pin &pin);
     void add_regs_post_route(int net_id, Pin &pin, int req_regs);
 };
@@ -1,9 +1,13 @@
 #include "graph.hh"
 #include "net.hh"
 #include "util.hh"
+#include <algorithm>
 #include <cassert>
+#include <cstdlib>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <tuple>
 #include <unordered_set>
 #include <queue>
 
@@ -39,8 +43,10 @@ Node::Node(NodeType type, const std::string &name, uint32_t x, uint32_t y,
         : type(type), name(name), width(width), x(x), y(y) {}
 
 Node::Node(NodeType type, const std::string &name, uint32_t x, uint32_t y,
-           uint32_t width, uint32_t track)
-        : type(type), name(name), width(width), track(track), x(x), y(y) {}
+           uint32_t width, uint32_t track,
+           std::pmr::memory_resource *resource)
+        : type(type), name(name), width(width), track(track), x(x), y(y),
+          neighbors_(resource), edge_costs_(resource), conn_in_(resource) {}
 
 Node::Node(const Node &node) : enable_shared_from_this() {
     type = node.type;
@@ -57,7 +63,7 @@ void Node::add_edge(const std::shared_ptr<Node> &node, uint32_t wire_delay) {
         throw std::runtime_error("Adding duplicated edge");
     }
     neighbors_.emplace_back(n);
-    edge_cost_[n] = node->delay + wire_delay;
+    edge_costs_.emplace_back(node->delay + wire_delay);
     node->conn_in_.emplace_back(weak_from_this());
 }
 
@@ -69,17 +75,18 @@ bool Node::has_edge(const std::shared_ptr<Node> &node) {
 
 uint32_t Node::get_edge_cost(const std::shared_ptr<Node> &node) {
     std::weak_ptr<Node> n = node;
-    if (std::find(neighbors_.begin(), neighbors_.end(), n) != neighbors_.end())
+    auto n_pos = std::find(neighbors_.begin(), neighbors_.end(), n);
+    if (n_pos == neighbors_.end())
         return 0xFFFFFF;
     else
-        return edge_cost_[node];
+        return edge_costs_[n_pos - neighbors_.begin()];
 }
 
 void Node::remove_edge(const std::shared_ptr<Node> &node) {
     auto n_pos = std::find(neighbors_.begin(), neighbors_.end(), node);
     if (n_pos != neighbors_.end()) {
+        edge_costs_.erase(edge_costs_.begin() + (n_pos - neighbors_.begin()));
         neighbors_.erase(n_pos);
-        edge_cost_.erase(node);
     } else {
         throw std::runtime_error("Removing non-existing edge");
     }
@@ -124,9 +131,10 @@ std::string RegisterNode::to_string() const {
 
 SwitchBoxNode::SwitchBoxNode(uint32_t x, uint32_t y, uint32_t width,
                              uint32_t track, SwitchBoxSide side,
-                             SwitchBoxIO io)
+                             SwitchBoxIO io,
+                             std::pmr::memory_resource *resource)
         : Node(NodeType::SwitchBox, "", x, y,
-               width, track), side(side), io(io) {}
+               width, track, resource), side(side), io(io) {}
 
 SwitchBoxNode::SwitchBoxNode(const SwitchBoxNode &node) :
         SwitchBoxNode(node.x, node.y, node.width, node.track, node.side, node.io) {}
@@ -143,8 +151,17 @@ Switch::Switch(uint32_t x, uint32_t y, uint32_t num_track, uint32_t num_horizont
                const std::set<std::tuple<uint32_t,
                        SwitchBoxSide, uint32_t,
                        SwitchBoxSide>> &internal_wires)
-        : x(x), y(y), num_track(num_track), num_horizontal_track(num_horizontal_track), width(width), id(switch_id),
-          internal_wires_(internal_wires) {
+        : Switch(x, y, ::make_shared<const SwitchTemplate>(
+                SwitchTemplate{num_track, num_horizontal_track, width,
+                               switch_id, internal_wires})) {}
+
+Switch::Switch(uint32_t x, uint32_t y,
+               const std::shared_ptr<const SwitchTemplate> &switch_template,
+               const std::shared_ptr<NodeArena> &arena)
+        : x(x), y(y), num_track(switch_template->num_track),
+          num_horizontal_track(switch_template->num_horizontal_track),
+          width(switch_template->width), id(switch_template->id),
+          template_(switch_template) {
     
     bool isTall = num_horizontal_track > num_track; 
 
@@ -162,15 +179,15 @@ Switch::Switch(uint32_t x, uint32_t y, uint32_t num_track, uint32_t num_horizont
             sbs_[side][io] = ::vector<shared_ptr<SwitchBoxNode>>(num_actual_tracks);
             for (uint32_t i = 0; i < num_actual_tracks; i++) {
                 sbs_[side][io][i] =
-                        ::make_shared<SwitchBoxNode>(x, y, width, i,
-                                                     gsi(side),
-                                                     gii(io));
+                        NodeArena::create<SwitchBoxNode>(arena, x, y, width, i,
+                                                         gsi(side),
+                                                         gii(io));
             }
         }
     }
     // assign internal wiring
     // the order is always in to out
-    for (const auto &iter : internal_wires_) {
+    for (const auto &iter : template_->internal_wires) {
         auto[track_from, side_from, track_to, side_to] = iter;
         auto sb_from =
                 sbs_[gsv(side_from)][giv(SwitchBoxIO::SB_IN)][track_from];
@@ -196,6 +213,11 @@ Switch::operator[](const std::tuple<SwitchBoxSide,
     return sbs_[gsv(side)][giv(io)][track];
 }
 
+const ::vector<::shared_ptr<SwitchBoxNode>> &
+Switch::get_sbs(SwitchBoxSide side, SwitchBoxIO io) const {
+    return sbs_[gsv(side)][giv(io)];
+}
+
 const ::vector<::shared_ptr<SwitchBoxNode>>
 Switch::get_sbs_by_side(const SwitchBoxSide &side) const {
     ::vector<::shared_ptr<SwitchBoxNode>> result;
@@ -223,29 +245,38 @@ void Switch::remove_sb_nodes(SwitchBoxSide side, SwitchBoxIO io) {
     // then we clean up the internal wires that has reference to the side
     // and io. this is very useful to create a tall tiles that uses multiple
     // switches
-    ::set<std::tuple<uint32_t, SwitchBoxSide, uint32_t, SwitchBoxSide>>
-            wires_to_remove;
-    for (auto const &conn : internal_wires_) {
+    // since the template is shared, we make a copy of it
+    auto switch_template = *get_template();
+    auto &wires = switch_template.internal_wires;
+    for (auto it = wires.begin(); it != wires.end();) {
         SwitchBoxSide side_from, side_to;
-        std::tie(std::ignore, side_from, std::ignore, side_to) = conn;
-        if (io == SwitchBoxIO::SB_IN && side_from == side)
-            wires_to_remove.insert(conn);
-        else if (io == SwitchBoxIO::SB_OUT && side_to == side)
-            wires_to_remove.insert(conn);
+        std::tie(std::ignore, side_from, std::ignore, side_to) = *it;
+        if ((io == SwitchBoxIO::SB_IN && side_from == side) ||
+            (io == SwitchBoxIO::SB_OUT && side_to == side))
+            it = wires.erase(it);
+        else
+            it++;
     }
-    // remove them
-    for (auto const &conn : wires_to_remove)
-        internal_wires_.erase(conn);
+    template_ = ::make_shared<const SwitchTemplate>(std::move(switch_template));
+}
+
+std::shared_ptr<const SwitchTemplate> Switch::get_template() const {
+    if (num_track == template_->num_track &&
+        num_horizontal_track == template_->num_horizontal_track &&
+        width == template_->width && id == template_->id)
+        return template_;
+    return ::make_shared<const SwitchTemplate>(
+            SwitchTemplate{num_track, num_horizontal_track, width, id,
+                           template_->internal_wires});
 }
 
 Tile::Tile(uint32_t x, uint32_t y, uint32_t height, const Switch &switchbox)
-        : x(x), y(y), height(height), switchbox(x,
-                                                y,
-                                                switchbox.num_track,
-                                                switchbox.num_horizontal_track,
-                                                switchbox.width,
-                                                switchbox.id,
-                                                switchbox.internal_wires()) {
+        : Tile(x, y, height, switchbox.get_template()) { }
+
+Tile::Tile(uint32_t x, uint32_t y, uint32_t height,
+           const std::shared_ptr<const SwitchTemplate> &switch_template,
+           const std::shared_ptr<NodeArena> &arena)
+        : x(x), y(y), height(height), switchbox(x, y, switch_template, arena) {
 
 }
 
@@ -263,20 +294,122 @@ std::ostream &operator<<(std::ostream &out, const Tile &tile) {
 RoutingGraph::RoutingGraph(uint32_t width, uint32_t height,
                            const Switch &switchbox) {
     // pre allocate tiles
+    resize_grid(width, height);
+    // all the tiles share the same switch template
+    auto const switch_template = switchbox.get_template();
     for (uint32_t x = 0; x < width; x++) {
         for (uint32_t y = 0; y < height; y++) {
-            grid_.insert({{x, y},
-                          Tile(x, y, Switch(x,
-                                            y,
-                                            switchbox.num_track,
-                                            switchbox.num_horizontal_track,
-                                            switchbox.width,
-                                            switchbox.id,
-                                            switchbox.internal_wires()))});
+            add_tile(x, y, 1, switch_template);
         }
     }
 }
 
+void RoutingGraph::add_tile(const Tile &tile) {
+    if (has_tile(tile.x, tile.y))
+        return;
+    insert_tile(Tile(tile));
+}
+
+void RoutingGraph::add_tile(uint32_t x, uint32_t y, uint32_t height,
+                            const std::shared_ptr<const SwitchTemplate> &switch_template) {
+    if (has_tile(x, y))
+        return;
+    insert_tile(Tile(x, y, height, switch_template, arena_.arena));
+}
+
+void RoutingGraph::insert_tile(Tile &&tile) {
+    auto const x = tile.x;
+    auto const y = tile.y;
+    if (y >= height_)
+        resize_grid(std::max(width_, x + 1), y + 1);
+    else if (x >= width_)
+        resize_grid(x + 1, height_);
+    auto &slot = grid_[x * height_ + y];
+    slot = TileSlot{{{x, y}, std::move(tile)}, {}};
+
+    // hand out ids in a fixed order so that they are deterministic
+    auto const &t = slot->entry.second;
+    for (uint32_t side = 0; side < Switch::SIDES; side++) {
+        for (uint32_t io = 0; io < Switch::IOS; io++) {
+            for (auto const &sb : t.switchbox.get_sbs(gsi(side), gii(io)))
+                assign_id(*sb);
+        }
+    }
+    for (auto const &iter : t.ports) {
+        assign_id(*iter.second);
+        index_named_node(*slot, intern_name(NodeType::Port, iter.first),
+                         iter.second);
+    }
+    for (auto const &iter : t.registers) {
+        assign_id(*iter.second);
+        index_named_node(*slot, intern_name(NodeType::Register, iter.first),
+                         iter.second);
+    }
+    for (auto const &iter : t.rmux_nodes) {
+        assign_id(*iter.second);
+        index_named_node(*slot, intern_name(NodeType::Generic, iter.first),
+                         iter.second);
+    }
+}
+
+void RoutingGraph::remove_tile(const std::pair<uint32_t, uint32_t> &t) {
+    if (has_tile(t))
+        grid_[t.first * height_ + t.second].reset();
+}
+
+Tile &RoutingGraph::operator[](const std::pair<uint32_t, uint32_t> &tile) {
+    auto *slot = get_slot(tile.first, tile.second);
+    if (!slot)
+        throw std::out_of_range("unable to find tile");
+    return slot->entry.second;
+}
+
+RoutingGraph::TileIterator
+RoutingGraph::find(const std::pair<uint32_t, uint32_t> &tile) {
+    if (!has_tile(tile))
+        return end();
+    auto *pos = grid_.data() + tile.first * height_ + tile.second;
+    return {pos, grid_.data() + grid_.size()};
+}
+
+void RoutingGraph::resize_grid(uint32_t width, uint32_t height) {
+    if (height == height_) {
+        // column-major. appending columns doesn't move any tile around
+        grid_.resize(width * height);
+    } else {
+        ::vector<std::optional<TileSlot>> grid(width * height);
+        for (uint32_t x = 0; x < width_; x++) {
+            for (uint32_t y = 0; y < height_; y++)
+                grid[x * height + y] = std::move(grid_[x * height_ + y]);
+        }
+        grid_.swap(grid);
+    }
+    width_ = width;
+    height_ = height;
+}
+
+uint32_t RoutingGraph::intern_name(NodeType type, const std::string &name) {
+    auto &ids = name_ids_[type];
+    auto pos = ids.find(name);
+    if (pos != ids.end())
+        return pos->second;
+    auto const id = num_names_++;
+    ids.emplace(name, id);
+    return id;
+}
+
+void RoutingGraph::index_named_node(TileSlot &slot, uint32_t name_id,
+                                    const std::shared_ptr<Node> &node) {
+    if (slot.named_nodes.size() <= name_id)
+        slot.named_nodes.resize(name_id + 1);
+    slot.named_nodes[name_id] = node;
+}
+
+void RoutingGraph::assign_id(Node &node) {
+    if (node.id == Node::INVALID_ID)
+        node.id = num_nodes_++;
+}
+
 void RoutingGraph::add_edge(const Node &node1, const Node &node2,
                             uint32_t wire_delay) {
     // we don't use the nodes passed in, instead, we manage our own node
@@ -293,90 +426,115 @@ void RoutingGraph::add_edge(const Node &node1, const Node &node2,
         throw ::runtime_error("node2 width does not equal to node1 "
                               "node1: " + ::to_string(n1->width) + " "
                                                                    "node2: " + ::to_string(n2->width));
-    n1->add_edge(n2, wire_delay);
+    n1->add_edge(n2->shared_from_this(), wire_delay);
 }
 
-std::shared_ptr<Node> RoutingGraph::search_create_node(const Node &node) {
+NodeHandle RoutingGraph::search_create_node(const Node &node) {
     uint32_t x = node.x;
     uint32_t y = node.y;
 
-    if (grid_.find({x, y}) == grid_.end()) {
+    auto *slot = get_slot(x, y);
+    if (!slot) {
         // a new tile. creating on the fly not supported any more
         ostringstream stream;
         stream << "unable to find tile at (" << x << ", " << y << ")";
         throw ::runtime_error(stream.str());
-    } else {
-        // depends on which type the nodes is. we need to
-        // treat differently
-        auto &tile = grid_.at({x, y});
-        switch (node.type) {
-            case NodeType::Register:
-                if (tile.registers.find(node.name) == tile.registers.end())
-                    tile.registers[node.name] =
-                            ::make_shared<RegisterNode>(node.name,
-                                                        node.x,
-                                                        node.y,
-                                                        node.width,
-                                                        node.track);
-                return tile.registers.at(node.name);
-            case NodeType::Port:
-                if (tile.ports.find(node.name) == tile.ports.end())
-                    tile.ports[node.name] =
-                            ::make_shared<PortNode>(node.name, node.x,
-                                                    node.y, node.width);
-                return tile.ports.at(node.name);
-            case NodeType::SwitchBox: {
-                auto const &sb_node = dynamic_cast<const SwitchBoxNode &>(node);
-                auto const &track = sb_node.track;
-                auto const &side = sb_node.side;
-                auto const &io = sb_node.io;
-
-                // Tall SB 
-                if (tile.switchbox.num_horizontal_track > tile.switchbox.num_track) {
-                    if (static_cast<SwitchBoxSide>(side) == SwitchBoxSide::Left || static_cast<SwitchBoxSide>(side) == SwitchBoxSide::Right) {
-                        if (track > tile.switchbox.num_horizontal_track)
-                            throw ::runtime_error("node is on a track that doesn't "
-                                                "exist in the switch box");
-                    } else {
-                        if (track > tile.switchbox.num_track)
-                            throw ::runtime_error("node is on a track that doesn't "
-                                                "exist in the switch box");
-                    }
-                     
-                // Square SB (normal)     
-                } else {
-                      if (track > tile.switchbox.num_track)
-                            throw ::runtime_error("node is on a track that doesn't "
-                                                "exist in the switch box");
-                }
-              
-                return tile.switchbox[{track, side, io}];
+    }
+    auto &tile = slot->entry.second;
+    if (node.type == NodeType::SwitchBox) {
+        auto const &sb_node = dynamic_cast<const SwitchBoxNode &>(node);
+        auto const &track = sb_node.track;
+        auto const &side = sb_node.side;
+        auto const &io = sb_node.io;
+
+        // Tall SB
+        if (tile.switchbox.num_horizontal_track > tile.switchbox.num_track) {
+            if (static_cast<SwitchBoxSide>(side) == SwitchBoxSide::Left || static_cast<SwitchBoxSide>(side) == SwitchBoxSide::Right) {
+                if (track > tile.switchbox.num_horizontal_track)
+                    throw ::runtime_error("node is on a track that doesn't "
+                                          "exist in the switch box");
+            } else {
+                if (track > tile.switchbox.num_track)
+                    throw ::runtime_error("node is on a track that doesn't "
+                                          "exist in the switch box");
             }
-            case NodeType::Generic:
-                // genetic node
-                if (tile.rmux_nodes.find(node.name)
-                    == tile.rmux_nodes.end())
-                    tile.rmux_nodes[node.name] =
-                            ::make_shared<RegisterMuxNode>(node.name,
-                                                           node.x,
-                                                           node.y,
-                                                           node.width,
-                                                           node.track);
-                return tile.rmux_nodes.at(node.name);
+
+        // Square SB (normal)
+        } else {
+            if (track > tile.switchbox.num_track)
+                throw ::runtime_error("node is on a track that doesn't "
+                                      "exist in the switch box");
         }
+
+        return tile.switchbox[{track, side, io}].get();
     }
-    return nullptr;
+
+    // the rest are located by their interned names
+    auto const name_id = intern_name(node.type, node.name);
+    if (name_id < slot->named_nodes.size() && slot->named_nodes[name_id])
+        return slot->named_nodes[name_id].get();
+
+    // depends on which type the nodes is. we need to
+    // treat differently
+    ::shared_ptr<Node> result;
+    switch (node.type) {
+        case NodeType::Register: {
+            auto &reg = tile.registers[node.name];
+            if (!reg)
+                reg = NodeArena::create<RegisterNode>(arena_.arena,
+                                                      node.name,
+                                                      node.x,
+                                                      node.y,
+                                                      node.width,
+                                                      node.track);
+            result = reg;
+            break;
+        }
+        case NodeType::Port: {
+            auto &port = tile.ports[node.name];
+            if (!port)
+                port = NodeArena::create<PortNode>(arena_.arena, node.name,
+                                                   node.x, node.y, node.width);
+            result = port;
+            break;
+        }
+        case NodeType::Generic: {
+            // genetic node
+            auto &rmux = tile.rmux_nodes[node.name];
+            if (!rmux)
+                rmux = NodeArena::create<RegisterMuxNode>(arena_.arena,
+                                                          node.name,
+                                                          node.x,
+                                                          node.y,
+                                                          node.width,
+                                                          node.track);
+            result = rmux;
+            break;
+        }
+        default:
+            return nullptr;
+    }
+    assign_id(*result);
+    index_named_node(*slot, name_id, result);
+    return result.get();
 }
 
 std::shared_ptr<Node> RoutingGraph::get_port(const uint32_t &x,
                                              const uint32_t &y,
-                                             const std::string &port) {
-    if (grid_.find({x, y}) == grid_.end()) {
+                                             const std::string &port) const {
+    auto *slot = get_slot(x, y);
+    if (!slot) {
         std::stringstream ss;
         ss << "unable to find grid tile " << x << " " << y;
         throw ::runtime_error(ss.str());
     }
-    const Tile &t = grid_.at({x, y});
+    auto const &ids = name_ids_[NodeType::Port];
+    auto const pos = ids.find(port);
+    if (pos != ids.end() && pos->second < slot->named_nodes.size()
+        && slot->named_nodes[pos->second])
+        return slot->named_nodes[pos->second];
+    // the port might be added to the tile directly
+    const Tile &t = slot->entry.second;
     if (t.ports.find(port) == t.ports.end())
         throw ::runtime_error("unable to find port " + port);
     return t.ports.at(port);
@@ -386,76 +544,444 @@ std::shared_ptr<SwitchBoxNode>
 RoutingGraph::get_sb(const uint32_t &x, const uint32_t &y,
                      const SwitchBoxSide &side,
                      const uint32_t &track, const SwitchBoxIO &io) {
-    auto pos = make_pair(x, y);
-    if (grid_.find(pos) == grid_.end()) {
+    auto *slot = get_slot(x, y);
+    if (!slot) {
         throw ::runtime_error("unable to find tile");
     } else {
-        const auto &tile = grid_.at(pos);
+        const auto &tile = slot->entry.second;
         return tile.switchbox[{track, side, io}];
     }
 }
 
+CompiledGraph::CompiledGraph(const RoutingGraph &graph) {
+    // nodes are indexed by the ids handed out by the routing graph
+    auto const num_nodes = graph.num_nodes();
+    nodes_.resize(num_nodes);
+    type_.resize(num_nodes, NodeType::Port);
+    x_.resize(num_nodes, 0);
+    y_.resize(num_nodes, 0);
+    track_.resize(num_nodes, 0);
+    delay_.resize(num_nodes, 0);
+    side_.resize(num_nodes, 0);
+    io_.resize(num_nodes, 0);
+    switch_id_.resize(num_nodes, 0);
+
+    for (const auto &iter : graph) {
+        auto const &tile = iter.second;
+        auto const switch_id = tile.switchbox.id;
+        for (uint32_t side = 0; side < Switch::SIDES; side++) {
+            for (uint32_t io = 0; io < Switch::IOS; io++) {
+                for (auto const &sb : tile.switchbox.get_sbs(gsi(side), gii(io)))
+                    add_node(sb, switch_id);
+            }
+        }
+        for (auto const &port : tile.ports)
+            add_node(port.second, switch_id);
+        for (auto const &reg : tile.registers)
+            add_node(reg.second, switch_id);
+        for (auto const &rmux : tile.rmux_nodes)
+            add_node(rmux.second, switch_id);
+    }
+
+    // build the CSR arrays. the neighbor order is preserved
+    offsets_.reserve(nodes_.size() + 1);
+    offsets_.emplace_back(0);
+    for (auto const &node : nodes_) {
+        if (node) {
+            uint64_t i = 0;
+            for (auto const &n : *node) {
+                auto const next = n.lock();
+                edges_.emplace_back(Edge{get_id(next), node->edge_cost_at(i++)});
+            }
+        }
+        offsets_.emplace_back(static_cast<uint32_t>(edges_.size()));
+    }
+
+    index_registers();
+    index_tiles(graph);
+}
+
+void CompiledGraph::index_registers() {
+    // one hop first, then anything that can reach those
+    ::vector<bool> one_hop(nodes_.size(), false);
+    for (uint32_t id = 0; id < nodes_.size(); id++) {
+        for (auto const &edge : edges(id)) {
+            if (type_[edge.node] == NodeType::Register) {
+                one_hop[id] = true;
+                break;
+            }
+        }
+    }
+    near_register_ = one_hop;
+    for (uint32_t id = 0; id < nodes_.size(); id++) {
+        if (near_register_[id])
+            continue;
+        for (auto const &edge : edges(id)) {
+            if (one_hop[edge.node]) {
+                near_register_[id] = true;
+                break;
+            }
+        }
+    }
+}
+
+void CompiledGraph::index_tiles(const RoutingGraph &graph) {
+    // nodes are listed in the same order as they are added. a tile is
+    // described by its switch template and the attributes of its nodes in
+    // that order, so tiles with the same description have their
+    // equivalent nodes at the same position
+    using NodeKey = std::tuple<uint32_t, uint32_t, uint32_t, uint8_t, uint8_t,
+                               ::string>;
+    std::map<std::pair<uint32_t, ::vector<NodeKey>>, uint32_t> signatures;
+    tile_nodes_.assign(static_cast<uint64_t>(width_) * height_, {});
+    tile_signatures_.assign(tile_nodes_.size(), INVALID_ID);
+    tile_index_.assign(nodes_.size(), INVALID_ID);
+    tile_ports_.assign(tile_nodes_.size(), {});
+    for (const auto &iter : graph) {
+        auto const x = iter.first.first;
+        auto const y = iter.first.second;
+        if (x >= width_ || y >= height_)
+            continue;
+        auto const &tile = iter.second;
+        auto const index = static_cast<uint64_t>(y) * width_ + x;
+        auto &tile_nodes = tile_nodes_[index];
+        ::vector<NodeKey> keys;
+        auto add = [&](const ::shared_ptr<Node> &node) {
+            auto const id = node->id;
+            // nodes shared with another tile can't be translated
+            if (x_[id] != x || y_[id] != y || tile_index_[id] != INVALID_ID)
+                return;
+            tile_index_[id] = static_cast<uint32_t>(tile_nodes.size());
+            tile_nodes.emplace_back(id);
+            keys.emplace_back(static_cast<uint32_t>(type_[id]), track_[id],
+                              node->width, side_[id], io_[id], node->name);
+        };
+        for (uint32_t side = 0; side < Switch::SIDES; side++) {
+            for (uint32_t io = 0; io < Switch::IOS; io++) {
+                for (auto const &sb : tile.switchbox.get_sbs(gsi(side), gii(io)))
+                    add(sb);
+            }
+        }
+        for (auto const &port : tile.ports) {
+            add(port.second);
+            tile_ports_[index].emplace(port.first, port.second->id);
+        }
+        for (auto const &reg : tile.registers)
+            add(reg.second);
+        for (auto const &rmux : tile.rmux_nodes)
+            add(rmux.second);
+        auto const size = static_cast<uint32_t>(signatures.size());
+        tile_signatures_[index] = signatures.emplace(
+                ::make_pair(tile.switchbox.id, std::move(keys)), size).first->second;
+    }
+}
+
+std::shared_ptr<Node> CompiledGraph::get_port(uint32_t x, uint32_t y,
+                                              const ::string &port) const {
+    if (x >= width_ || y >= height_) {
+        std::stringstream ss;
+        ss << "unable to find grid tile " << x << " " << y;
+        throw ::runtime_error(ss.str());
+    }
+    auto const &ports = tile_ports_[static_cast<uint64_t>(y) * width_ + x];
+    auto const pos = ports.find(port);
+    if (pos == ports.end())
+        throw ::runtime_error("unable to find port " + port);
+    return nodes_[pos->second];
+}
+
+bool CompiledGraph::has_edge(uint32_t from, uint32_t to) const {
+    for (auto const &edge : edges(from)) {
+        if (edge.node == to)
+            return true;
+    }
+    return false;
+}
+
+uint32_t CompiledGraph::tile_signature(uint32_t x, uint32_t y) const {
+    if (x >= width_ || y >= height_)
+        return INVALID_ID;
+    return tile_signatures_[static_cast<uint64_t>(y) * width_ + x];
+}
+
+uint32_t CompiledGraph::translate(uint32_t id, int64_t dx, int64_t dy) const {
+    if (tile_index_[id] == INVALID_ID)
+        return INVALID_ID;
+    auto const x = static_cast<int64_t>(x_[id]) + dx;
+    auto const y = static_cast<int64_t>(y_[id]) + dy;
+    if (x < 0 || y < 0 || x >= width_ || y >= height_)
+        return INVALID_ID;
+    auto const signature = tile_signature(static_cast<uint32_t>(x),
+                                          static_cast<uint32_t>(y));
+    if (signature == INVALID_ID || signature != tile_signature(x_[id], y_[id]))
+        return INVALID_ID;
+    return tile_nodes_[y * width_ + x][tile_index_[id]];
+}
+
+void CompiledGraph::add_node(const std::shared_ptr<Node> &node,
+                             uint32_t switch_id) {
+    auto const id = node->id;
+    if (id >= nodes_.size())
+        throw ::runtime_error("invalid node id for " + node->to_string());
+    if (nodes_[id]) {
+        if (nodes_[id] == node)
+            return;
+        throw ::runtime_error("duplicated node id for " + node->to_string());
+    }
+    nodes_[id] = node;
+
+    type_[id] = node->type;
+    x_[id] = node->x;
+    y_[id] = node->y;
+    track_[id] = node->track;
+    delay_[id] = node->delay;
+    if (node->type == NodeType::SwitchBox) {
+        auto const *sb = dynamic_cast<const SwitchBoxNode *>(node.get());
+        side_[id] = static_cast<uint8_t>(gsv(sb->side));
+        io_[id] = static_cast<uint8_t>(giv(sb->io));
+    }
+    switch_id_[id] = switch_id;
+    width_ = std::max(width_, node->x + 1);
+    height_ = std::max(height_, node->y + 1);
+}
+
+uint32_t CompiledGraph::get_id(const Node *node) const {
+    if (!has_node(node)) {
+        if (node == nullptr)
+            throw ::runtime_error("unable to find id for null node");
+        throw ::runtime_error("unable to find id for " + node->to_string());
+    }
+    return node->id;
+}
+
+std::vector<uint32_t>
+CompiledGraph::get_ids(const std::vector<std::shared_ptr<Node>> &nodes) const {
+    ::vector<uint32_t> result;
+    result.reserve(nodes.size());
+    for (auto const &node : nodes)
+        result.emplace_back(get_id(node));
+    return result;
+}
+
+std::vector<std::shared_ptr<Node>>
+CompiledGraph::get_nodes(const std::vector<uint32_t> &ids) const {
+    ::vector<::shared_ptr<Node>> result;
+    result.reserve(ids.size());
+    for (auto const id : ids)
+        result.emplace_back(nodes_[id]);
+    return result;
+}
+
+std::vector<NodeHandle>
+CompiledGraph::get_handles(const std::vector<uint32_t> &ids) const {
+    ::vector<NodeHandle> result;
+    result.reserve(ids.size());
+    for (auto const id : ids)
+        result.emplace_back(nodes_[id].get());
+    return result;
+}
+
+std::vector<uint32_t>
+CompiledGraph::get_ids(const std::vector<NodeHandle> &nodes) const {
+    ::vector<uint32_t> result;
+    result.reserve(nodes.size());
+    for (auto const node : nodes)
+        result.emplace_back(get_id(node));
+    return result;
+}
+
+std::vector<std::shared_ptr<Node>>
+CompiledGraph::get_nodes(const std::vector<NodeHandle> &nodes) const {
+    ::vector<::shared_ptr<Node>> result;
+    result.reserve(nodes.size());
+    for (auto const node : nodes)
+        result.emplace_back(nodes_[get_id(node)]);
+    return result;
+}
+
+uint32_t CompiledGraph::manhattan_distance(
+        uint32_t id, const std::pair<uint32_t, uint32_t> &pos) const {
+    int dx = x_[id] - pos.first;
+    int dy = y_[id] - pos.second;
+
+    return static_cast<uint32_t>(abs(dx) + abs(dy));
+}
+
+uint32_t CompiledGraph::manhattan_distance(uint32_t id1, uint32_t id2) const {
+    return manhattan_distance(id1, {x_[id2], y_[id2]});
+}
+
 RoutedGraph::RoutedGraph(const std::map<const Pin *, std::vector<std::shared_ptr<Node>>> &route) {
-    std::set<std::pair<const Node *, const Node *>> visited;
+    // collect every node once, ordered by their routing graph id
+    std::vector<std::pair<uint32_t, const shared_ptr<Node> *>> entries;
+    uint64_t num_entries = 0;
+    for (auto const &iter: route) num_entries += iter.second.size();
+    entries.reserve(num_entries);
+    for (auto const &iter: route) {
+        for (auto const &node: iter.second) {
+            if (node->id == Node::INVALID_ID)
+                throw runtime_error("Routed node " + node->name + " does not belong to a routing graph");
+            entries.emplace_back(node->id, &node);
+        }
+    }
+    std::sort(entries.begin(), entries.end(),
+              [](const auto &a, const auto &b) { return a.first < b.first; });
+    entries.erase(std::unique(entries.begin(), entries.end(),
+                              [](const auto &a, const auto &b) { return a.first == b.first; }),
+                  entries.end());
+
+    ids_.reserve(entries.size());
+    nodes_.reserve(entries.size());
+    for (auto const &[id, node]: entries) {
+        ids_.emplace_back(id);
+        append_node(*node);
+    }
+    edges_.reserve(num_entries);
+
     for (auto const &[pin, segment]: route) {
         for (uint64_t i = 1; i < segment.size(); i++) {
-            auto const &pre_node_ = segment[i - 1];
-            auto const &current_node_ = segment[i];
-            auto pre_node = get_node(pre_node_);
-            auto current_node = get_node(current_node_);
+            auto pre_node = find_node(segment[i - 1].get());
+            auto current_node = find_node(segment[i].get());
 
             // add edge
-            auto connection = std::make_pair(pre_node.get(), current_node.get());
-            if (visited.find(connection) == visited.end()) {
-                visited.emplace(connection);
-                pre_node->add_edge(current_node);
+            if (find_edge(pre_node, current_node) == NONE) {
+                add_edge(pre_node, current_node);
             }
-
         }
-        pins_.emplace(pin, get_node(segment.back()));
+        pins_.emplace(pin, find_node(segment.back().get()));
     }
     // src node has to be the one that doesn't have src
-    for (auto const &iter: internal_to_normal_) {
-        auto const &n = iter.first;
-        if (n->get_conn_in().empty()) {
-            src_node_ = n;
+    for (uint32_t i = 0; i < nodes_.size(); i++) {
+        if (num_parents_[i] == 0) {
+            src_node_ = i;
             break;
         }
     }
 }
 
-std::shared_ptr<Node> RoutedGraph::get_node(const std::shared_ptr<Node> &node) {
-    if (normal_to_internal_.find(node) == normal_to_internal_.end()) {
-        auto n = node->clone();
-        normal_to_internal_.emplace(node, n);
-        internal_to_normal_.emplace(n, node);
+void RoutedGraph::append_node(const std::shared_ptr<Node> &node) {
+    nodes_.emplace_back(node);
+    first_child_.emplace_back(NONE);
+    last_child_.emplace_back(NONE);
+    first_parent_.emplace_back(NONE);
+    last_parent_.emplace_back(NONE);
+    num_children_.emplace_back(0);
+    num_parents_.emplace_back(0);
+}
+
+uint32_t RoutedGraph::find_node(const Node *node) const {
+    auto it = std::lower_bound(ids_.begin(), ids_.end(), node->id);
+    if (it != ids_.end() && *it == node->id)
+        return static_cast<uint32_t>(it - ids_.begin());
+    // inserted registers and connections live in the overlay
+    for (auto i = static_cast<uint32_t>(ids_.size()); i < nodes_.size(); i++) {
+        if (nodes_[i]->id == node->id)
+            return i;
+    }
+    return NONE;
+}
+
+uint32_t RoutedGraph::get_node(const std::shared_ptr<Node> &node) {
+    auto index = find_node(node.get());
+    if (index == NONE) {
+        if (node->id == Node::INVALID_ID)
+            throw runtime_error("Routed node " + node->name + " does not belong to a routing graph");
+        index = static_cast<uint32_t>(nodes_.size());
+        append_node(node);
+    }
+    return index;
+}
+
+uint32_t RoutedGraph::find_edge(uint32_t from, uint32_t to) const {
+    for (auto e = first_child_[from]; e != NONE; e = edges_[e].next_child) {
+        if (edges_[e].to == to)
+            return e;
+    }
+    return NONE;
+}
+
+void RoutedGraph::add_edge(uint32_t from, uint32_t to) {
+    if (find_edge(from, to) != NONE)
+        throw runtime_error("Adding duplicated edge");
+    auto e = static_cast<uint32_t>(edges_.size());
+    edges_.emplace_back(Edge{from, to, NONE, NONE});
+    if (last_child_[from] == NONE)
+        first_child_[from] = e;
+    else
+        edges_[last_child_[from]].next_child = e;
+    last_child_[from] = e;
+    if (last_parent_[to] == NONE)
+        first_parent_[to] = e;
+    else
+        edges_[last_parent_[to]].next_parent = e;
+    last_parent_[to] = e;
+    num_children_[from]++;
+    num_parents_[to]++;
+}
+
+void RoutedGraph::remove_edge(uint32_t from, uint32_t to) {
+    // unlink from the child list of from
+    uint32_t pre = NONE;
+    uint32_t e = first_child_[from];
+    while (e != NONE && edges_[e].to != to) {
+        pre = e;
+        e = edges_[e].next_child;
     }
-    return normal_to_internal_.at(node);
+    if (e == NONE)
+        throw runtime_error("Removing non-existing edge");
+    if (pre == NONE)
+        first_child_[from] = edges_[e].next_child;
+    else
+        edges_[pre].next_child = edges_[e].next_child;
+    if (last_child_[from] == e)
+        last_child_[from] = pre;
+
+    // unlink from the parent list of to
+    pre = NONE;
+    for (auto p = first_parent_[to]; p != e; p = edges_[p].next_parent)
+        pre = p;
+    if (pre == NONE)
+        first_parent_[to] = edges_[e].next_parent;
+    else
+        edges_[pre].next_parent = edges_[e].next_parent;
+    if (last_parent_[to] == e)
+        last_parent_[to] = pre;
+
+    num_children_[from]--;
+    num_parents_[to]--;
+}
+
+uint32_t RoutedGraph::first_child(uint32_t node) const {
+    auto e = first_child_[node];
+    return e == NONE ? NONE : edges_[e].to;
+}
+
+uint32_t RoutedGraph::first_parent(uint32_t node) const {
+    auto e = first_parent_[node];
+    return e == NONE ? NONE : edges_[e].from;
 }
 
 std::map<uint32_t, std::vector<std::shared_ptr<Node>>> RoutedGraph::get_route() const {
     std::map<uint32_t, std::vector<std::shared_ptr<Node>>> result;
-    std::unordered_set<const Node *> visited;
+    std::vector<bool> visited(nodes_.size(), false);
 
     for (auto const &[pin, pin_node]: pins_) {
         std::vector<std::shared_ptr<Node>> segment;
-        std::shared_ptr<Node> n = pin_node;
+        auto n = pin_node;
 
-        while (n) {
-            segment.emplace_back(internal_to_normal_.at(n));
+        while (n != NONE) {
+            segment.emplace_back(nodes_[n]);
 
-            if (visited.find(n.get()) != visited.end()) {
+            if (visited[n]) {
                 // fan-out net
                 break;
             }
-            visited.emplace(n.get());
+            visited[n] = true;
 
-            auto const &conn_to = n->get_conn_in();
-            if (conn_to.size() == 1) {
-                auto w_n = conn_to[0];
-                n = w_n.lock();
+            if (num_parents_[n] == 1) {
+                n = first_parent(n);
             } else {
-                if (conn_to.size() > 1)
+                if (num_parents_[n] > 1)
                     throw std::runtime_error("ERROR");
                 break;
             }
@@ -473,7 +999,7 @@ std::vector<uint32_t>
 RoutedGraph::pin_order(const std::map<uint32_t, std::vector<std::shared_ptr<Node>>> &routes) const {
     std::unordered_set<uint32_t> finished;
     std::unordered_set<const Node *> visited;
-    visited.emplace(internal_to_normal_.at(src_node_).get());
+    visited.emplace(nodes_.at(src_node_).get());
     std::vector<uint32_t> result;
     while (finished.size() != routes.size()) {
         for (auto const &[pin_id, segment]: routes) {
@@ -492,80 +1018,77 @@ RoutedGraph::pin_order(const std::map<uint32_t, std::vector<std::shared_ptr<Node
 }
 
 
-std::set<const Pin *> RoutedGraph::insert_reg_output(std::shared_ptr<Node> src_node, bool reverse) {
+std::set<const Pin *> RoutedGraph::insert_reg_output(const std::shared_ptr<Node> &src_node, bool reverse) {
+    auto index = find_node(src_node.get());
+    if (index == NONE)
+        throw runtime_error("Unable to find " + src_node->name + " in the routed graph");
+    return insert_reg_output(index, reverse);
+}
+
+std::set<const Pin *> RoutedGraph::insert_reg_output(uint32_t src_node, bool reverse) {
     // we cannot insert pass a branch
-    // mapped from normal to internal
-    if (normal_to_internal_.find(src_node) != normal_to_internal_.end()) {
-        src_node = normal_to_internal_.at(src_node);
-    }
     while (true) {
-        if (src_node->type == NodeType::SwitchBox) {
-            auto sb = std::reinterpret_pointer_cast<SwitchBoxNode>(src_node);
+        auto const &node = nodes_[src_node];
+        if (node->type == NodeType::SwitchBox) {
+            auto sb = std::reinterpret_pointer_cast<SwitchBoxNode>(node);
             if (sb->io == SwitchBoxIO::SB_OUT) {
                 // make sure we haven't pipelined this register
-                auto next = sb->begin()->lock();
-                if (next->type != NodeType::Register)
+                auto next = first_child(src_node);
+                if (next == NONE || nodes_[next]->type != NodeType::Register)
                     break;
             }
         }
 
-        if (reverse) {
-            if (src_node->get_conn_in().empty()) {
-                throw std::runtime_error("Route completely full. Unable to insert pipeline registers");
-            }
-            src_node = src_node->get_conn_in().begin()->lock();
-        } else {
-            if (src_node->size() == 0) {
-                throw std::runtime_error("Route completely full. Unable to insert pipeline registers");
-            }
-            src_node = src_node->begin()->lock();
+        auto next = reverse ? first_parent(src_node) : first_child(src_node);
+        if (next == NONE) {
+            throw std::runtime_error("Route completely full. Unable to insert pipeline registers");
         }
-
+        src_node = next;
     }
 
-    auto next = src_node->begin()->lock();
+    auto next = first_child(src_node);
     std::shared_ptr<Node> reg;
-    auto const &original_src_node = internal_to_normal_.at(src_node);
-    for (auto const &n: *original_src_node) {
+    for (auto const &n: *nodes_[src_node]) {
         auto node = n.lock();
         if (node->type == NodeType::Register) {
             reg = node;
             break;
         }
     }
-    if (!reg) {
+    if (!reg || next == NONE) {
         throw std::runtime_error("Unable to find pipeline register");
     }
 
-    src_node->remove_edge(next);
+    remove_edge(src_node, next);
     auto reg_net = get_node(reg);
-    src_node->add_edge(reg_net);
-    reg_net->add_edge(next);
+    add_edge(src_node, reg_net);
+    add_edge(reg_net, next);
 
     // figure out the affected pins
     // assume no loop
     std::set<const Pin *> pins;
-    std::queue<const Node *> nodes;
-    nodes.emplace(next.get());
-    std::unordered_set<const Node *> visited;
+    std::queue<uint32_t> nodes;
+    nodes.emplace(next);
+    std::vector<bool> visited(nodes_.size(), false);
     while (!nodes.empty()) {
-        auto const *n = nodes.front();
+        auto n = nodes.front();
         nodes.pop();
-        visited.emplace(n);
-        if (n->type == NodeType::Port || n->type == NodeType::Register) {
+        visited[n] = true;
+        auto type = nodes_[n]->type;
+        if (type == NodeType::Port || type == NodeType::Register) {
             // need to figure out which pins gets affected
             for (auto const &[pin, pin_node]: pins_) {
-                if (pin_node.get() == n) {
+                if (pin_node == n) {
                     pins.emplace(pin);
                 }
             }
         }
-        for (auto const &nn: *n) {
-            auto const &node_ptr = nn.lock();
-            if (visited.find(node_ptr.get()) != visited.end()) {
+        for (auto e = first_child_[n]; e != NONE; e = edges_[e].next_child) {
+            auto child = edges_[e].to;
+            if (visited[child]) {
                 throw std::runtime_error("Loop detected. This is an error");
             }
-            nodes.emplace(node_ptr.get());
+            nodes.emplace(child);
         }
     }
 
@@ -584,47 +1107,49 @@ std::set<const Pin *> RoutedGraph::insert_pipeline_reg(const Pin * pin) {
     for (auto const &iter: pins_) full_nodes.emplace(iter.first);
 
     // figure out if we have any branch in the segments
-    auto const &pin_node = pins_.at(pin);
+    auto pin_node = pins_.at(pin);
 
     // need to see if we have a free RMUX node
     // couple sanity check
-    if (pin_node->get_conn_in().size() != 1) {
+    if (num_parents_[pin_node] != 1) {
         throw std::runtime_error("Unexpected pin connection");
     }
 
     // we insert it right after the source sink, if possible
 
-    auto sb = pin_node->get_conn_in().front().lock();
+    auto sb = first_parent(pin_node);
     // if that switch box has two outputs already, we insert at the very beginning.
-    if (sb->size() > 1) {
-        auto pins = insert_reg_output(src_node_);
+    if (num_children_[sb] > 1) {
+        auto pins = insert_reg_output(src_node_, false);
         if (pins.size() != full_nodes.size()) {
             throw std::runtime_error("Unable to insert registers to all pins from source");
         }
         return full_nodes;
     }
     // need to make sure the source is a rmux node
-    std::shared_ptr<Node> rmux;
-    if (sb->type == NodeType::Generic) {
+    uint32_t rmux;
+    if (nodes_[sb]->type == NodeType::Generic) {
         // this only happens when we are trying to insert pipeline registers before the IO ports
         rmux = sb;
     } else {
         // if it's not rmux, which is very likely the case
-        rmux = sb->get_conn_in().front().lock();
+        rmux = first_parent(sb);
     }
 
-    if (!rmux || rmux->type != NodeType::Generic || internal_to_normal_.at(rmux)->get_conn_in().size() != 2) {
+    // Note: the number of rmux inputs is checked against the routing graph
+    if (rmux == NONE || nodes_[rmux]->type != NodeType::Generic || nodes_[rmux]->get_conn_in().size() != 2 ||
+        num_parents_[rmux] == 0) {
         throw std::runtime_error("Unable to find register mux");
     }
 
-    auto pre_node = rmux->get_conn_in().front().lock();
-    if (pre_node->type == NodeType::Register) {
+    auto pre_node = first_parent(rmux);
+    if (nodes_[pre_node]->type == NodeType::Register) {
         // we already register it. try one more step
         auto pins = insert_reg_output(pre_node, true);
         return pins;
     }
 
-    auto pins = insert_reg_output(pre_node);
+    auto pins = insert_reg_output(pre_node, false);
     if (pins.empty()) {
         throw std::runtime_error("Unable to insert a single register to the targeted pin");
     }
@@ -636,43 +1161,31 @@ std::set<const Pin *> RoutedGraph::insert_pipeline_reg(const Pin * pin) {
 std::vector<std::shared_ptr<Node>> RoutedGraph::get_sink_to_src_route(const Pin *pin) const {
     std::vector<std::shared_ptr<Node>> result;
     auto node = pins_.at(pin);
-    while (node) {
-        result.emplace_back(internal_to_normal_.at(node));
-        auto const &conn_in = node->get_conn_in();
-        if (conn_in.empty()) {
-            node = nullptr;
-        } else {
-            node = conn_in[0].lock();
-        }
+    while (node != NONE) {
+        result.emplace_back(nodes_[node]);
+        node = first_parent(node);
     }
 
     return result;
 }
 
-std::shared_ptr<Node> RoutedGraph::get_internal_node(const std::shared_ptr<Node> &normal) const {
-    if (normal_to_internal_.find(normal) != normal_to_internal_.end()) {
-        return normal_to_internal_.at(normal);
-    } else {
-        return nullptr;
-    }
-}
-
 void RoutedGraph::connect(const std::shared_ptr<Node> &src, const std::shared_ptr<Node> &sink) {
     auto pre_node = get_node(src);
     auto current_node = get_node(sink);
 
     // add edge
-    if (!pre_node->has_edge(current_node)) {
-        pre_node->add_edge(current_node);
+    if (find_edge(pre_node, current_node) == NONE) {
+        add_edge(pre_node, current_node);
     }
 }
 
 void RoutedGraph::remove_connection(const std::shared_ptr<Node> &src, const std::shared_ptr<Node> &sink) {
-    auto pre_node = get_node(src);
-    auto current_node = get_node(sink);
+    auto pre_node = find_node(src.get());
+    auto current_node = find_node(sink.get());
+    if (pre_node == NONE || current_node == NONE)
+        return;
 
-    // add edge
-    if (pre_node->has_edge(current_node)) {
-        pre_node->remove_edge(current_node);
+    if (find_edge(pre_node, current_node) != NONE) {
+        remove_edge(pre_node, current_node);
     }
 }
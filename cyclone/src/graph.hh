@@ -3,7 +3,10 @@
 
 #include <set>
 #include <memory>
+#include <memory_resource>
 #include <map>
+#include <mutex>
+#include <optional>
 #include <vector>
 #include <iostream>
 #include <unordered_map>
@@ -54,6 +57,10 @@ public:
     // used for delay calculation routing
     uint32_t delay = 1;
 
+    // stable index assigned by the routing graph when the node is created.
+    // it is used to index the dense look up tables in the router
+    uint32_t id = INVALID_ID;
+
     virtual void add_edge(const std::shared_ptr<Node> &node)
     { add_edge(node, DEFAULT_WIRE_DELAY); }
     virtual void add_edge(const std::shared_ptr<Node> &node,
@@ -62,6 +69,8 @@ public:
     bool has_edge(const std::shared_ptr<Node> &node);
 
     uint32_t get_edge_cost(const std::shared_ptr<Node> &node);
+    // cost of the i-th edge, in the same order as the iteration below
+    uint32_t edge_cost_at(uint64_t index) const { return edge_costs_[index]; }
 
     // helper function to allow iteration
     auto begin() const { return neighbors_.begin(); }
@@ -69,7 +78,7 @@ public:
     uint64_t size() { return neighbors_.size(); }
 
     // used in creating mux in hardware
-    const std::vector<std::weak_ptr<Node>> &get_conn_in() const { return conn_in_; }
+    const std::pmr::vector<std::weak_ptr<Node>> &get_conn_in() const { return conn_in_; }
 
     virtual std::string to_string() const;
     friend std::ostream& operator<<(std::ostream &s, const Node &node) {
@@ -80,6 +89,7 @@ public:
 
     const static int IO = 2;
     const static uint32_t DEFAULT_WIRE_DELAY = 0;
+    static constexpr uint32_t INVALID_ID = 0xFFFFFFFF;
 
     virtual ~Node() = default;
 
@@ -87,24 +97,28 @@ protected:
     Node(NodeType type, const std::string &name, uint32_t x, uint32_t y);
     Node(NodeType type, const std::string &name, uint32_t x, uint32_t y,
          uint32_t width);
+    // adjacency lists are allocated from the memory resource, which is the
+    // arena of the routing graph if the node is created by the graph
     Node(NodeType type, const std::string &name, uint32_t x, uint32_t y,
-         uint32_t width, uint32_t track);
+         uint32_t width, uint32_t track,
+         std::pmr::memory_resource *resource = std::pmr::get_default_resource());
 
     // TODO: change this to std::weak_ptr to avoid memory leak due to circular
     // TODO: reference.
-    std::vector<std::weak_ptr<Node>> neighbors_;
-    std::map<std::weak_ptr<Node>, uint32_t,
-             std::owner_less<std::weak_ptr<Node>>> edge_cost_;
+    std::pmr::vector<std::weak_ptr<Node>> neighbors_;
+    // edge cost of neighbors_[i] is stored at edge_costs_[i]
+    std::pmr::vector<uint32_t> edge_costs_;
 
 private:
-    std::vector<std::weak_ptr<Node>>conn_in_;
+    std::pmr::vector<std::weak_ptr<Node>> conn_in_;
 };
 
 class RegisterMuxNode : public Node {
 public:
     RegisterMuxNode(const std::string &name, uint32_t x, uint32_t y,
-             uint32_t width, uint32_t track) :
-             Node(NodeType::Generic, name, x, y, width, track) {}
+             uint32_t width, uint32_t track,
+             std::pmr::memory_resource *resource = std::pmr::get_default_resource()) :
+             Node(NodeType::Generic, name, x, y, width, track, resource) {}
     RegisterMuxNode(const std::string &name, uint32_t x, uint32_t y)
             : Node(NodeType::Generic, name, x, y) {}
     std::string to_string() const override;
@@ -115,7 +129,9 @@ public:
 class PortNode : public Node {
 public:
     PortNode(const std::string &name, uint32_t x, uint32_t y,
-             uint32_t width) : Node(NodeType::Port, name, x, y, width) {}
+             uint32_t width,
+             std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+        : Node(NodeType::Port, name, x, y, width, 0, resource) {}
     PortNode(const std::string &name, uint32_t x, uint32_t y)
         : Node(NodeType::Port, name, x, y) {}
     std::string to_string() const override;
@@ -126,8 +142,9 @@ public:
 class RegisterNode : public Node {
 public:
     RegisterNode(const std::string &name, uint32_t x, uint32_t y,
-                 uint32_t width, uint32_t track)
-        : Node(NodeType::Register, name, x, y, width, track) { }
+                 uint32_t width, uint32_t track,
+                 std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+        : Node(NodeType::Register, name, x, y, width, track, resource) { }
 
     std::string to_string() const override;
 
@@ -144,7 +161,8 @@ public:
 class SwitchBoxNode : public Node {
 public:
     SwitchBoxNode(uint32_t x, uint32_t y, uint32_t width, uint32_t track,
-                  SwitchBoxSide side, SwitchBoxIO io);
+                  SwitchBoxSide side, SwitchBoxIO io,
+                  std::pmr::memory_resource *resource = std::pmr::get_default_resource());
 
     SwitchBoxNode(const SwitchBoxNode &node);
 
@@ -162,6 +180,95 @@ public:
 bool operator==(const Node &node1, const Node &node2);
 bool operator==(const std::shared_ptr<Node> &ptr, const Node &node);
 
+// non-owning handle to a node. it's valid as long as the routing graph that
+// owns the node is alive, and is used internally where we don't need to share
+// the ownership
+using NodeHandle = Node *;
+
+// memory arena owned by a routing graph. nodes, together with their
+// adjacency lists, are carved out of a few large blocks instead of being
+// allocated one by one. deallocation is a no-op: the blocks are released
+// all at once when the arena goes away, and the space of adjacency lists
+// that grow is not reused, which costs at most as much as the lists.
+// allocation is locked since nodes shared by copies of a graph may have
+// edges added through either copy.
+// Note:
+// the arena is reference counted by every node allocated from it, so that
+// nodes handed out to the users, e.g. through python, stay valid after the
+// graph is gone
+class NodeArena : public std::pmr::memory_resource {
+public:
+    std::pmr::memory_resource *resource() { return this; }
+
+    // allocator that keeps the arena alive
+    template <typename T>
+    class Allocator {
+    public:
+        using value_type = T;
+
+        explicit Allocator(std::shared_ptr<NodeArena> arena)
+            : arena_(std::move(arena)) {}
+        template <typename U>
+        Allocator(const Allocator<U> &allocator)
+            : arena_(allocator.arena_) {}
+
+        T *allocate(std::size_t n) {
+            return static_cast<T *>(arena_->resource()->allocate(
+                    n * sizeof(T), alignof(T)));
+        }
+        void deallocate(T *p, std::size_t n) {
+            arena_->resource()->deallocate(p, n * sizeof(T), alignof(T));
+        }
+
+        template <typename U>
+        bool operator==(const Allocator<U> &allocator) const
+        { return arena_ == allocator.arena_; }
+        template <typename U>
+        bool operator!=(const Allocator<U> &allocator) const
+        { return arena_ != allocator.arena_; }
+
+    private:
+        std::shared_ptr<NodeArena> arena_;
+
+        template <typename U> friend class Allocator;
+    };
+
+    // allocate a node from the arena. falls back to the heap if no arena
+    // is given
+    template <typename T, typename ...Args>
+    static std::shared_ptr<T> create(const std::shared_ptr<NodeArena> &arena,
+                                     Args &&...args) {
+        if (!arena)
+            return std::make_shared<T>(std::forward<Args>(args)...);
+        return std::allocate_shared<T>(Allocator<T>(arena),
+                                       std::forward<Args>(args)...,
+                                       arena->resource());
+    }
+
+private:
+    std::mutex mutex_;
+    std::pmr::monotonic_buffer_resource buffer_;
+
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+        std::lock_guard<std::mutex> guard(mutex_);
+        return buffer_.allocate(bytes, alignment);
+    }
+    void do_deallocate(void *, std::size_t, std::size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource &other)
+    const noexcept override { return this == &other; }
+};
+
+
+// immutable description of a switch box type. switches of the same type share
+// one instance, so that the internal wires are not copied for every tile
+struct SwitchTemplate {
+    uint32_t num_track;
+    uint32_t num_horizontal_track;
+    uint32_t width;
+    uint32_t id;
+    std::set<std::tuple<uint32_t, SwitchBoxSide, uint32_t, SwitchBoxSide>>
+    internal_wires;
+};
 
 class Switch {
 
@@ -171,6 +278,11 @@ public:
            const std::set<std::tuple<uint32_t,
                           SwitchBoxSide, uint32_t,
                           SwitchBoxSide>> &internal_wires);
+    // only the switch box nodes are created, from the arena if provided.
+    // the template is shared
+    Switch(uint32_t x, uint32_t y,
+           const std::shared_ptr<const SwitchTemplate> &switch_template,
+           const std::shared_ptr<NodeArena> &arena = nullptr);
 
     uint32_t x;
     uint32_t y;
@@ -196,18 +308,26 @@ public:
 
     const std::vector<std::shared_ptr<SwitchBoxNode>>
     get_sbs_by_side(const SwitchBoxSide &side) const;
+    // same as above but without copying
+    const std::vector<std::shared_ptr<SwitchBoxNode>> &
+    get_sbs(SwitchBoxSide side, SwitchBoxIO io) const;
 
-    const std::set<std::tuple<uint32_t, SwitchBoxSide, uint32_t, SwitchBoxSide>>
-    internal_wires() const { return internal_wires_; }
+    const std::set<std::tuple<uint32_t, SwitchBoxSide, uint32_t, SwitchBoxSide>> &
+    internal_wires() const { return template_->internal_wires; }
+
+    // template to create switches of the same type. if the public attributes
+    // have been changed, a new template is created to reflect that
+    std::shared_ptr<const SwitchTemplate> get_template() const;
 
     void remove_sb_nodes(SwitchBoxSide side, SwitchBoxIO io);
 
     static constexpr char TOKEN[] = "SWITCH";
 
 private:
-    // this is used to construct internal connection of switch boxes
-    std::set<std::tuple<uint32_t, SwitchBoxSide, uint32_t, SwitchBoxSide>>
-    internal_wires_;
+    // this is used to construct internal connection of switch boxes.
+    // Note:
+    // it is shared among switches. copy it before making any changes
+    std::shared_ptr<const SwitchTemplate> template_;
 
     std::vector<std::shared_ptr<SwitchBoxNode>> sbs_[SIDES][IOS];
 
@@ -233,6 +353,9 @@ struct Tile {
     Tile(uint32_t x, uint32_t y, const Switch &switchbox)
         : Tile(x, y, 1, switchbox) { };
     Tile(uint32_t x, uint32_t y, uint32_t height, const Switch &switchbox);
+    Tile(uint32_t x, uint32_t y, uint32_t height,
+         const std::shared_ptr<const SwitchTemplate> &switch_template,
+         const std::shared_ptr<NodeArena> &arena = nullptr);
 
     static constexpr char TOKEN[] = "TILE";
     std::string to_string() const;
@@ -243,6 +366,13 @@ std::ostream& operator<<(std::ostream &out, const Tile &tile);
 
 
 class RoutingGraph {
+    // a tile together with the look up table of its named nodes, i.e. ports,
+    // registers and rmux nodes, indexed by the interned name id
+    struct TileSlot {
+        std::pair<std::pair<uint32_t, uint32_t>, Tile> entry;
+        std::vector<std::shared_ptr<Node>> named_nodes;
+    };
+
 public:
     RoutingGraph() : grid_() {}
     // helper constructors to create the grid efficiently
@@ -250,8 +380,11 @@ public:
                  const Switch &switchbox);
 
     // manually add tiles
-    void add_tile(const Tile &tile) { grid_.insert({{tile.x, tile.y}, tile}); }
-    void remove_tile(const std::pair<uint32_t, uint32_t> &t) { grid_.erase(t); }
+    void add_tile(const Tile &tile);
+    // create the tile in place. its nodes are allocated from the arena
+    void add_tile(uint32_t x, uint32_t y, uint32_t height,
+                  const std::shared_ptr<const SwitchTemplate> &switch_template);
+    void remove_tile(const std::pair<uint32_t, uint32_t> &t);
 
     // used to construct the routing graph.
     // called after tiles have been constructed.
@@ -270,33 +403,250 @@ public:
            const SwitchBoxIO &io);
     std::shared_ptr<Node> get_port(const uint32_t &x,
                                    const uint32_t &y,
-                                   const std::string &port);
+                                   const std::string &port) const;
+
+    // helper class to iterate through the tiles in the same (x, y) order as
+    // a std::map keyed by the tile coordinates. empty slots are skipped.
+    // Slot is const for the const iterator
+    template <typename Slot>
+    class BasicTileIterator {
+    public:
+        BasicTileIterator(Slot *pos, Slot *end) : pos_(pos), end_(end)
+        { skip(); }
+        auto &operator*() const { return (*pos_)->entry; }
+        auto *operator->() const { return &(*pos_)->entry; }
+        BasicTileIterator &operator++() { pos_++; skip(); return *this; }
+        bool operator==(const BasicTileIterator &iter) const
+        { return pos_ == iter.pos_; }
+        bool operator!=(const BasicTileIterator &iter) const
+        { return pos_ != iter.pos_; }
+
+    private:
+        Slot *pos_;
+        Slot *end_;
+
+        void skip() { while (pos_ != end_ && !pos_->has_value()) pos_++; }
+    };
+    using TileIterator = BasicTileIterator<std::optional<TileSlot>>;
+    using ConstTileIterator = BasicTileIterator<const std::optional<TileSlot>>;
 
     // helper functions to iterate through the entire graph
-    std::map<std::pair<uint32_t, uint32_t>, Tile>::iterator
-    begin() { return grid_.begin(); }
-    std::map<std::pair<uint32_t, uint32_t>, Tile>::iterator
-    end() { return grid_.end(); }
-    // and direct assess
-    Tile &operator[](const std::pair<uint32_t, uint32_t> &tile)
-    { return grid_.at(tile); };
-    std::map<std::pair<uint32_t, uint32_t>, Tile>::iterator
-    find(const std::pair<uint32_t, uint32_t> &tile)
-    { return grid_.find(tile); }
+    TileIterator begin()
+    { return {grid_.data(), grid_.data() + grid_.size()}; }
+    TileIterator end()
+    { return {grid_.data() + grid_.size(), grid_.data() + grid_.size()}; }
+    ConstTileIterator begin() const
+    { return {grid_.data(), grid_.data() + grid_.size()}; }
+    ConstTileIterator end() const
+    { return {grid_.data() + grid_.size(), grid_.data() + grid_.size()}; }
+    // and direct assess. notice that adding tiles outside the current grid
+    // may move the tiles around, which invalidates the references
+    Tile &operator[](const std::pair<uint32_t, uint32_t> &tile);
+    TileIterator find(const std::pair<uint32_t, uint32_t> &tile);
+    // returns nullptr if the tile does not exist
+    Tile *get_tile(uint32_t x, uint32_t y)
+    { auto *slot = get_slot(x, y); return slot ? &slot->entry.second : nullptr; }
 
     bool has_tile(const std::pair<uint32_t, uint32_t> &coord)
-    { return grid_.find(coord) != grid_.end(); }
+    { return get_slot(coord.first, coord.second) != nullptr; }
     bool has_tile(uint32_t x, uint32_t y) { return has_tile({x, y}); };
 
+    // number of node ids handed out so far. ids are in [0, num_nodes())
+    uint32_t num_nodes() const { return num_nodes_; }
+
 private:
-    // grid is for fast locating the nodes. no longer used for routing
-    std::map<std::pair<uint32_t, uint32_t>, Tile> grid_;
+    // grid is for fast locating the nodes. no longer used for routing.
+    // tiles are stored column-major, i.e. at x * height_ + y, which gives
+    // the same iteration order as the original std::map
+    std::vector<std::optional<TileSlot>> grid_;
+    uint32_t width_ = 0;
+    uint32_t height_ = 0;
+    uint32_t num_nodes_ = 0;
+
+    // every copy of the graph allocates its new nodes from an arena of its
+    // own. the nodes it shares with the original keep their arena alive
+    struct ArenaRef {
+        std::shared_ptr<NodeArena> arena = std::make_shared<NodeArena>();
+
+        ArenaRef() = default;
+        ArenaRef(const ArenaRef &) {}
+        ArenaRef(ArenaRef &&) = default;
+        ArenaRef &operator=(const ArenaRef &)
+        { arena = std::make_shared<NodeArena>(); return *this; }
+        ArenaRef &operator=(ArenaRef &&) = default;
+    };
+    ArenaRef arena_;
+
+    // node names interned per node type. the ids are shared among all the
+    // tiles so that named nodes can be located without string comparisons
+    std::unordered_map<std::string, uint32_t> name_ids_[NodeType::Generic + 1];
+    uint32_t num_names_ = 0;
+
+    TileSlot *get_slot(uint32_t x, uint32_t y) {
+        if (x >= width_ || y >= height_ || !grid_[x * height_ + y])
+            return nullptr;
+        return &(*grid_[x * height_ + y]);
+    }
+    const TileSlot *get_slot(uint32_t x, uint32_t y) const {
+        if (x >= width_ || y >= height_ || !grid_[x * height_ + y])
+            return nullptr;
+        return &(*grid_[x * height_ + y]);
+    }
+    void resize_grid(uint32_t width, uint32_t height);
+    uint32_t intern_name(NodeType type, const std::string &name);
+    void index_named_node(TileSlot &slot, uint32_t name_id,
+                          const std::shared_ptr<Node> &node);
+    void insert_tile(Tile &&tile);
+
+    NodeHandle search_create_node(const Node &node);
+    void assign_id(Node &node);
+};
 
-    std::shared_ptr<Node> search_create_node(const Node &node);
+// read-only "compiled" form of the routing graph. nodes are indexed by their
+// ids and edges are stored in CSR format, i.e. the edges of node i are
+// [offsets[i], offsets[i + 1]) of the edge array, where each entry holds the
+// neighbor id together with the edge cost. node attributes are stored as
+// separate arrays (SoA) so that the router can search the graph without
+// chasing any pointers.
+// Note:
+// this is a snapshot. changes made to the routing graph after compilation
+// will not be reflected. it is never modified after construction, hence can
+// be shared among routers, which keep their own routing states
+class CompiledGraph {
+public:
+    CompiledGraph() = default;
+    explicit CompiledGraph(const RoutingGraph &graph);
+
+    struct Edge {
+        uint32_t node;
+        uint32_t cost;
+    };
+
+    // helper class to allow range-based iteration over the edges of a node
+    class EdgeRange {
+    public:
+        EdgeRange(const Edge *begin, const Edge *end)
+            : begin_(begin), end_(end) {}
+        const Edge *begin() const { return begin_; }
+        const Edge *end() const { return end_; }
+        uint32_t size() const { return static_cast<uint32_t>(end_ - begin_); }
+
+    private:
+        const Edge *begin_;
+        const Edge *end_;
+    };
+
+    static constexpr uint32_t INVALID_ID = Node::INVALID_ID;
+
+    // notice that ids of removed nodes are left as holes, i.e. get_node()
+    // returns nullptr and the node has no edges
+    uint32_t size() const { return static_cast<uint32_t>(nodes_.size()); }
+    uint32_t num_edges() const
+    { return static_cast<uint32_t>(edges_.size()); }
+
+    // map between ids and the original nodes. the nodes are only kept as a
+    // thin view for the python binding and the routing result
+    uint32_t get_id(const Node *node) const;
+    uint32_t get_id(const std::shared_ptr<Node> &node) const
+    { return get_id(node.get()); }
+    bool has_node(const Node *node) const
+    { return node && node->id < size() && nodes_[node->id].get() == node; }
+    const std::shared_ptr<Node> &get_node(uint32_t id) const
+    { return nodes_[id]; }
+    std::vector<uint32_t>
+    get_ids(const std::vector<std::shared_ptr<Node>> &nodes) const;
+    std::vector<std::shared_ptr<Node>>
+    get_nodes(const std::vector<uint32_t> &ids) const;
+    // the same with handles, see NodeHandle, which are used where the
+    // ownership is not needed
+    std::vector<NodeHandle> get_handles(const std::vector<uint32_t> &ids) const;
+    std::vector<uint32_t> get_ids(const std::vector<NodeHandle> &nodes) const;
+    std::vector<std::shared_ptr<Node>>
+    get_nodes(const std::vector<NodeHandle> &nodes) const;
+
+    // edge access. yields (neighbor, cost) pairs in the original order
+    EdgeRange edges(uint32_t id) const
+    { return {edges_.data() + offsets_[id], edges_.data() + offsets_[id + 1]}; }
+    uint32_t degree(uint32_t id) const
+    { return offsets_[id + 1] - offsets_[id]; }
+
+    // node attributes
+    NodeType type(uint32_t id) const { return type_[id]; }
+    uint32_t x(uint32_t id) const { return x_[id]; }
+    uint32_t y(uint32_t id) const { return y_[id]; }
+    uint32_t track(uint32_t id) const { return track_[id]; }
+    uint32_t delay(uint32_t id) const { return delay_[id]; }
+    // only meaningful for switch box nodes
+    SwitchBoxSide side(uint32_t id) const
+    { return static_cast<SwitchBoxSide>(side_[id]); }
+    SwitchBoxIO io(uint32_t id) const
+    { return static_cast<SwitchBoxIO>(io_[id]); }
+    // id of the switch template used by the tile the node belongs to
+    uint32_t switch_id(uint32_t id) const { return switch_id_[id]; }
+    // whether a register can be reached from the node within two hops.
+    // computed once since it's checked in the goal test of reg net routing
+    bool near_register(uint32_t id) const { return near_register_[id]; }
+    bool has_edge(uint32_t from, uint32_t to) const;
+
+    // tiles with the same switch template and the same nodes share a
+    // signature. INVALID_ID if there is no tile at the location
+    uint32_t tile_signature(uint32_t x, uint32_t y) const;
+    // the same node of the tile (dx, dy) tiles away if that tile has the same
+    // signature, INVALID_ID otherwise
+    uint32_t translate(uint32_t id, int64_t dx, int64_t dy) const;
+
+    // size of the grid covered by the nodes
+    uint32_t width() const { return width_; }
+    uint32_t height() const { return height_; }
+
+    uint32_t manhattan_distance(uint32_t id,
+                                const std::pair<uint32_t, uint32_t> &pos) const;
+    uint32_t manhattan_distance(uint32_t id1, uint32_t id2) const;
+
+    // the nodes are shared with the routing graph it's compiled from, but the
+    // graph itself is not kept. ports are looked up by the tile they are in
+    std::shared_ptr<Node> get_port(uint32_t x, uint32_t y,
+                                   const std::string &port) const;
+
+private:
+    std::vector<std::shared_ptr<Node>> nodes_;
+
+    // CSR
+    std::vector<uint32_t> offsets_;
+    std::vector<Edge> edges_;
+
+    // SoA
+    std::vector<NodeType> type_;
+    std::vector<uint32_t> x_;
+    std::vector<uint32_t> y_;
+    std::vector<uint32_t> track_;
+    std::vector<uint32_t> delay_;
+    std::vector<uint8_t> side_;
+    std::vector<uint8_t> io_;
+    std::vector<uint32_t> switch_id_;
+    std::vector<bool> near_register_;
+    // nodes of every tile in a fixed order, indexed by y * width + x, and the
+    // position of every node in its tile
+    std::vector<std::vector<uint32_t>> tile_nodes_;
+    std::vector<uint32_t> tile_signatures_;
+    std::vector<uint32_t> tile_index_;
+    // port ids by name, indexed the same way as tile_nodes_
+    std::vector<std::map<std::string, uint32_t>> tile_ports_;
+
+    uint32_t width_ = 0;
+    uint32_t height_ = 0;
+
+    void add_node(const std::shared_ptr<Node> &node, uint32_t switch_id);
+    void index_registers();
+    void index_tiles(const RoutingGraph &graph);
 };
 
 // hold information for routed graph
-// all nodes are cloned from the original routing graph
+// nodes are referred to by a local index, looked up from the original routing
+// graph node id. edges are kept in a single pool and chained into per-node
+// child and parent lists, so building a routed graph does not clone or
+// allocate per node. pipeline registers inserted afterwards are appended as
+// overlay entries
 struct Pin;
 class RoutedGraph {
 public:
@@ -309,23 +659,53 @@ public:
 
     [[nodiscard]] std::set<const Pin *> insert_pipeline_reg(const Pin * pin);
 
-    [[nodiscard]] std::set<const Pin *> insert_reg_output(std::shared_ptr<Node> src_node, bool reverse = false);
+    [[nodiscard]] std::set<const Pin *> insert_reg_output(const std::shared_ptr<Node> &src_node, bool reverse = false);
 
     [[nodiscard]] std::vector<std::shared_ptr<Node>> get_sink_to_src_route(const Pin *pin) const;
 
-    [[nodiscard]] std::shared_ptr<Node> get_internal_node(const std::shared_ptr<Node> &normal) const;
+    [[nodiscard]] bool has_node(const std::shared_ptr<Node> &node) const { return find_node(node.get()) != NONE; }
+    [[nodiscard]] uint64_t size() const { return nodes_.size(); }
 
     void connect(const std::shared_ptr<Node> &src, const std::shared_ptr<Node> &sink);
     void remove_connection(const std::shared_ptr<Node> &src, const std::shared_ptr<Node> &sink);
 
 private:
-    // our node to the actual routing graph node
-    std::unordered_map<std::shared_ptr<Node>, std::shared_ptr<Node>> normal_to_internal_;
-    std::unordered_map<std::shared_ptr<Node>, std::shared_ptr<Node>> internal_to_normal_;
-    std::map<const Pin *, std::shared_ptr<Node>> pins_;
-    std::shared_ptr<Node> src_node_;
-
-    std::shared_ptr<Node> get_node(const std::shared_ptr<Node> &node);
+    static constexpr uint32_t NONE = 0xFFFFFFFF;
+    struct Edge {
+        uint32_t from;
+        uint32_t to;
+        uint32_t next_child;
+        uint32_t next_parent;
+    };
+
+    // local index to the actual routing graph node
+    std::vector<std::shared_ptr<Node>> nodes_;
+    // sorted node ids of the nodes from the initial route. local index is
+    // the position in this array. anything after it is an overlay entry
+    std::vector<uint32_t> ids_;
+    // per-node edge lists, in insertion order
+    std::vector<uint32_t> first_child_;
+    std::vector<uint32_t> last_child_;
+    std::vector<uint32_t> first_parent_;
+    std::vector<uint32_t> last_parent_;
+    std::vector<uint32_t> num_children_;
+    std::vector<uint32_t> num_parents_;
+    // removed edges are unlinked but stay in the pool
+    std::vector<Edge> edges_;
+
+    std::map<const Pin *, uint32_t> pins_;
+    uint32_t src_node_ = NONE;
+
+    uint32_t find_node(const Node *node) const;
+    uint32_t get_node(const std::shared_ptr<Node> &node);
+    void append_node(const std::shared_ptr<Node> &node);
+    uint32_t find_edge(uint32_t from, uint32_t to) const;
+    void add_edge(uint32_t from, uint32_t to);
+    void remove_edge(uint32_t from, uint32_t to);
+    uint32_t first_child(uint32_t node) const;
+    uint32_t first_parent(uint32_t node) const;
+
+    std::set<const Pin *> insert_reg_output(uint32_t src_node, bool reverse);
 };
 
 #endif //CYCLONE_GRAPH_H
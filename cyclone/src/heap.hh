@@ -0,0 +1,154 @@
+#ifndef CYCLONE_HEAP_HH
+#define CYCLONE_HEAP_HH
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// indexed d-ary min-heap over node ids. every node is in the heap at most
+// once, and its key can be decreased in place, so the heap does not grow
+// with stale duplicates. entries with the same key are ordered by node id
+// to keep the search deterministic.
+// the position table is indexed by node id, hence reserve() has to be
+// called with the number of nodes before use. clear() only touches the
+// entries in the heap
+template <typename Key, uint32_t D = 4>
+class IndexedHeap {
+public:
+    static constexpr uint32_t NONE = 0xFFFFFFFF;
+
+    void reserve(uint32_t num_nodes) {
+        if (pos_.size() < num_nodes)
+            pos_.resize(num_nodes, NONE);
+    }
+
+    bool empty() const { return heap_.empty(); }
+    uint32_t size() const { return static_cast<uint32_t>(heap_.size()); }
+    bool contains(uint32_t node) const { return pos_[node] != NONE; }
+
+    uint32_t top() const { return heap_.front().second; }
+    Key top_key() const { return heap_.front().first; }
+
+    void push(uint32_t node, Key key) {
+        auto const index = size();
+        heap_.emplace_back(key, node);
+        pos_[node] = index;
+        sift_up(index);
+    }
+
+    // key has to be no larger than the current one
+    void decrease(uint32_t node, Key key) {
+        auto const index = pos_[node];
+        heap_[index].first = key;
+        sift_up(index);
+    }
+
+    void pop() {
+        pos_[heap_.front().second] = NONE;
+        if (heap_.size() > 1) {
+            heap_.front() = heap_.back();
+            pos_[heap_.front().second] = 0;
+            heap_.pop_back();
+            sift_down(0);
+        } else {
+            heap_.pop_back();
+        }
+    }
+
+    void clear() {
+        for (auto const &entry: heap_)
+            pos_[entry.second] = NONE;
+        heap_.clear();
+    }
+
+private:
+    std::vector<std::pair<Key, uint32_t>> heap_;
+    std::vector<uint32_t> pos_;
+
+    static bool less(const std::pair<Key, uint32_t> &a,
+                     const std::pair<Key, uint32_t> &b) {
+        return a.first < b.first ||
+               (a.first == b.first && a.second < b.second);
+    }
+
+    void move_to(uint32_t index, const std::pair<Key, uint32_t> &entry) {
+        heap_[index] = entry;
+        pos_[entry.second] = index;
+    }
+
+    void sift_up(uint32_t index) {
+        auto const entry = heap_[index];
+        while (index > 0) {
+            auto const parent = (index - 1) / D;
+            if (!less(entry, heap_[parent]))
+                break;
+            move_to(index, heap_[parent]);
+            index = parent;
+        }
+        move_to(index, entry);
+    }
+
+    void sift_down(uint32_t index) {
+        auto const entry = heap_[index];
+        auto const n = size();
+        while (true) {
+            auto const first = index * D + 1;
+            if (first >= n)
+                break;
+            auto const last = first + D < n ? first + D : n;
+            auto best = first;
+            for (auto child = first + 1; child < last; child++) {
+                if (less(heap_[child], heap_[best]))
+                    best = child;
+            }
+            if (!less(heap_[best], entry))
+                break;
+            move_to(index, heap_[best]);
+            index = best;
+        }
+        move_to(index, entry);
+    }
+};
+
+// monotone bucket queue for integer keys, i.e. Dial's algorithm. keys
+// pushed can not be smaller than the last popped one, which holds for
+// Dijkstra with non-negative integer edge costs. stale entries are not
+// removed; callers are expected to skip them when popped.
+// it's used to profile the lookahead, where the costs are the integer edge
+// delays. the A* search keeps the IndexedHeap since its costs are doubles
+class BucketQueue {
+public:
+    bool empty() const { return size_ == 0; }
+
+    void push(uint32_t node, uint32_t key) {
+        if (key >= buckets_.size())
+            buckets_.resize(key + 1);
+        buckets_[key].emplace_back(node);
+        size_++;
+    }
+
+    // returns (key, node)
+    std::pair<uint32_t, uint32_t> pop() {
+        while (buckets_[current_].empty())
+            current_++;
+        auto const node = buckets_[current_].back();
+        buckets_[current_].pop_back();
+        size_--;
+        return {current_, node};
+    }
+
+    // buckets keep their capacity
+    void clear() {
+        for (auto &bucket: buckets_)
+            bucket.clear();
+        current_ = 0;
+        size_ = 0;
+    }
+
+private:
+    std::vector<std::vector<uint32_t>> buckets_;
+    uint32_t current_ = 0;
+    uint64_t size_ = 0;
+};
+
+#endif //CYCLONE_HEAP_HH
@@ -134,7 +134,7 @@ void print_sb(std::ofstream &out, const std::string &pad, const Switch &sb) {
     out << Switch::TOKEN << " " << sb.width << " " << sb.id << " "
         << sb.num_track << endl;
     out << BEGIN << endl;
-    const auto wires = sb.internal_wires();
+    auto const &wires = sb.internal_wires();
     for (auto const &iter : wires) {
         auto [track_from, side_from, track_to, side_to] = iter;
         out << pad << track_from << " " << gsv(side_from) << " "
@@ -322,7 +322,8 @@ RoutingGraph load_routing_graph(const std::string &filename) {
 
     RoutingGraph g;
     ::string line;
-    ::map<int, Switch> switch_map;
+    // switch templates are shared among the tiles of the same type
+    ::map<int, std::shared_ptr<const SwitchTemplate>> switch_map;
 
     // reading per tile
     while(std::getline(in, line)) {
@@ -359,8 +360,10 @@ RoutingGraph load_routing_graph(const std::string &filename) {
                 SwitchBoxSide side_to = gsi(stou(line_tokens[3]));
                 wires.insert({track_from, side_from, track_to, side_to});
             }
-            Switch switchbox(0, 0, num_track, num_horizontal_track, width, id, wires);
-            switch_map.insert({id, switchbox});
+            auto switch_template = std::make_shared<const SwitchTemplate>(
+                    SwitchTemplate{num_track, num_horizontal_track, width, id,
+                                   std::move(wires)});
+            switch_map.insert({id, switch_template});
         }
         else if (line_tokens[0] == Tile::TOKEN) {
             if (line_tokens.size() != 5)
@@ -370,9 +373,7 @@ RoutingGraph load_routing_graph(const std::string &filename) {
             uint32_t height = stou(line_tokens[3]);
             uint32_t switch_id = stou(line_tokens[4]);
 
-            auto switchbox = switch_map.at(switch_id);
-            Tile tile(x, y, height, switchbox);
-            g.add_tile(tile);
+            g.add_tile(x, y, height, switch_map.at(switch_id));
         }
     }
     // we have to create all tiles first
@@ -403,6 +404,24 @@ RoutingGraph load_routing_graph(const std::string &filename) {
     return g;
 }
 
+std::shared_ptr<const Lookahead>
+load_lookahead(std::shared_ptr<const CompiledGraph> graph,
+               const std::string &graph_filename) {
+    auto const filename = graph_filename + ".lookahead";
+    auto lookahead = Lookahead::load(graph, filename);
+    if (lookahead)
+        return lookahead;
+
+    lookahead = std::make_shared<Lookahead>(std::move(graph));
+    try {
+        lookahead->dump(filename);
+    } catch (const std::runtime_error &ex) {
+        // not fatal. we just have to profile it again next time
+        std::cerr << ex.what() << std::endl;
+    }
+    return lookahead;
+}
+
 void dump_routing_result(const Router &r, const std::string &filename) {
     std::ofstream out;
     out.open(filename, std::ofstream::out | std::ofstream::app);
@@ -5,6 +5,7 @@
 #include <map>
 #include <vector>
 #include "graph.hh"
+#include "lookahead.hh"
 #include "route.hh"
 
 std::pair<std::map<std::string, std::vector<std::pair<std::string,
@@ -21,6 +22,13 @@ void dump_wave_info(const std::map<std::string, uint64_t> &wave_info, const std:
 
 RoutingGraph load_routing_graph(const std::string &filename);
 
+// lookahead tables are persisted next to the graph file as
+// <graph_filename>.lookahead. they are profiled and written out if the file
+// is missing or does not match the graph
+std::shared_ptr<const Lookahead>
+load_lookahead(std::shared_ptr<const CompiledGraph> graph,
+               const std::string &graph_filename);
+
 void dump_routing_result(const Router &r, const std::string &filename);
 
 void setup_router_input(Router &r, const std::string &packed_filename,
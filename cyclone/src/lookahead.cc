@@ -0,0 +1,265 @@
+#include "lookahead.hh"
+#include "heap.hh"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
+
+using std::map;
+using std::pair;
+using std::shared_ptr;
+using std::vector;
+using std::runtime_error;
+
+constexpr char LOOKAHEAD[] = "LOOKAHEAD";
+constexpr char GRAPH[] = "GRAPH";
+constexpr char ROW[] = "ROW";
+constexpr uint32_t VERSION = 2;
+
+Lookahead::Lookahead(std::shared_ptr<const CompiledGraph> graph)
+    : graph_(std::move(graph)) {
+    if (!graph_)
+        throw ::runtime_error("lookahead requires a routing graph");
+    profile();
+}
+
+Lookahead::SourceClass Lookahead::get_source_class(uint32_t node) const {
+    auto const &g = *graph_;
+    auto const type = g.type(node);
+    if (type == NodeType::SwitchBox) {
+        return {g.switch_id(node), type, g.track(node),
+                static_cast<uint32_t>(g.side(node)),
+                static_cast<uint32_t>(g.io(node))};
+    }
+    return {g.switch_id(node), type, g.track(node), 0, 0};
+}
+
+uint32_t Lookahead::index(uint32_t row, int dx, int dy,
+                          uint32_t sink_type) const {
+    auto const &g = *graph_;
+    auto const x = static_cast<uint32_t>(dx + static_cast<int>(g.width()) - 1);
+    auto const y = static_cast<uint32_t>(dy + static_cast<int>(g.height()) - 1);
+    return ((row * span_x_ + x) * span_y_ + y) * NUM_SINK_TYPES + sink_type;
+}
+
+void Lookahead::index_nodes(const std::map<SourceClass, uint32_t> &row_ids) {
+    auto const &g = *graph_;
+    node_row_.assign(g.size(), NO_ROW);
+    for (uint32_t id = 0; id < g.size(); id++) {
+        if (!g.get_node(id))
+            continue;
+        auto iter = row_ids.find(get_source_class(id));
+        if (iter != row_ids.end())
+            node_row_[id] = iter->second;
+    }
+}
+
+void Lookahead::compute_tile_cost() {
+    // a path to a tile d tiles away crosses at least d tiles in total, so
+    // its cost is at least d times the lowest cost per tile crossed
+    auto const &g = *graph_;
+    tile_cost_ = -1;
+    for (uint32_t id = 0; id < g.size(); id++) {
+        for (auto const &edge: g.edges(id)) {
+            auto const dist = g.manhattan_distance(id, edge.node);
+            if (dist == 0)
+                continue;
+            auto const cost = static_cast<double>(edge.cost) / dist;
+            if (tile_cost_ < 0 || cost < tile_cost_)
+                tile_cost_ = cost;
+        }
+    }
+    if (tile_cost_ < 0)
+        tile_cost_ = 0;
+}
+
+void Lookahead::profile() {
+    auto const &g = *graph_;
+    span_x_ = g.width() > 0 ? 2 * g.width() - 1 : 0;
+    span_y_ = g.height() > 0 ? 2 * g.height() - 1 : 0;
+    compute_tile_cost();
+
+    // group the nodes by location and type, which are the targets of the
+    // searches. rows are numbered in source class order
+    map<pair<uint32_t, uint32_t>, map<uint32_t, vector<uint32_t>>> targets;
+    map<SourceClass, uint32_t> row_ids;
+    for (uint32_t id = 0; id < g.size(); id++) {
+        if (!g.get_node(id))
+            continue;
+        targets[{g.x(id), g.y(id)}][g.type(id)].emplace_back(id);
+        row_ids.emplace(get_source_class(id), 0);
+    }
+    for (auto &[source_class, row]: row_ids) {
+        row = static_cast<uint32_t>(rows_.size());
+        rows_.emplace_back(source_class);
+    }
+    values_.assign(static_cast<uint64_t>(rows_.size()) * row_size(), UNREACHED);
+    index_nodes(row_ids);
+
+    // the searches go backwards, i.e. from the sinks along the incoming
+    // edges
+    vector<uint32_t> in_offsets(g.size() + 1, 0);
+    for (uint32_t id = 0; id < g.size(); id++) {
+        for (auto const &edge: g.edges(id))
+            in_offsets[edge.node + 1]++;
+    }
+    for (uint32_t id = 0; id < g.size(); id++)
+        in_offsets[id + 1] += in_offsets[id];
+    vector<CompiledGraph::Edge> in_edges(g.num_edges());
+    {
+        auto pos = in_offsets;
+        for (uint32_t id = 0; id < g.size(); id++) {
+            for (auto const &edge: g.edges(id))
+                in_edges[pos[edge.node]++] = {id, edge.cost};
+        }
+    }
+
+    // reused across the searches. only the touched entries are reset
+    vector<uint32_t> cost(g.size(), UNREACHED);
+    vector<uint32_t> touched;
+    // edge costs are integers, hence a bucket queue is sufficient
+    BucketQueue working_set;
+
+    for (auto const &[pos, types]: targets) {
+        auto const target_x = static_cast<int>(pos.first);
+        auto const target_y = static_cast<int>(pos.second);
+        for (auto const &[sink_type, sinks]: types) {
+            for (auto const id: touched)
+                cost[id] = UNREACHED;
+            touched.clear();
+
+            // Dijkstra on the edge cost only, from all the sinks at once
+            working_set.clear();
+            for (auto const sink: sinks) {
+                cost[sink] = 0;
+                touched.emplace_back(sink);
+                working_set.push(sink, 0);
+            }
+            while (!working_set.empty()) {
+                auto const [c, head] = working_set.pop();
+                if (c > cost[head])
+                    continue;
+                auto const row = node_row_[head];
+                auto &value = values_[index(row,
+                                            target_x - static_cast<int>(g.x(head)),
+                                            target_y - static_cast<int>(g.y(head)),
+                                            sink_type)];
+                value = std::min(value, c);
+                for (auto i = in_offsets[head]; i < in_offsets[head + 1]; i++) {
+                    auto const &edge = in_edges[i];
+                    auto const next_cost = c + edge.cost;
+                    if (next_cost < cost[edge.node]) {
+                        if (cost[edge.node] == UNREACHED)
+                            touched.emplace_back(edge.node);
+                        cost[edge.node] = next_cost;
+                        working_set.push(edge.node, next_cost);
+                    }
+                }
+            }
+        }
+    }
+}
+
+uint32_t Lookahead::estimate(uint32_t node, uint32_t sink) const {
+    auto const &g = *graph_;
+    return estimate(node, {g.x(sink), g.y(sink)}, g.type(sink));
+}
+
+uint32_t Lookahead::estimate(uint32_t node,
+                             const std::pair<uint32_t, uint32_t> &pos,
+                             NodeType sink_type) const {
+    auto const &g = *graph_;
+    auto const dist = static_cast<uint32_t>(g.manhattan_distance(node, pos) *
+                                            tile_cost_);
+    auto const row = node_row_[node];
+    if (row == NO_ROW || pos.first >= g.width() || pos.second >= g.height())
+        return dist;
+    auto const value = values_[index(row,
+                                     static_cast<int>(pos.first) - static_cast<int>(g.x(node)),
+                                     static_cast<int>(pos.second) - static_cast<int>(g.y(node)),
+                                     sink_type)];
+    return value == UNREACHED ? dist : value;
+}
+
+void Lookahead::dump(const std::string &filename) const {
+    auto const &g = *graph_;
+    std::ofstream out(filename);
+    if (!out.good())
+        throw ::runtime_error("unable to write lookahead to " + filename);
+    out << LOOKAHEAD << " " << VERSION << std::endl;
+    out << GRAPH << " " << g.size() << " " << g.num_edges() << " "
+        << g.width() << " " << g.height() << " " << rows_.size() << std::endl;
+    auto const size = row_size();
+    for (uint32_t row = 0; row < rows_.size(); row++) {
+        auto const &[switch_id, type, track, side, io] = rows_[row];
+        out << ROW << " " << switch_id << " " << type << " " << track << " "
+            << side << " " << io << std::endl;
+        // unreached entries are written as -1
+        auto const *values = values_.data() + static_cast<uint64_t>(row) * size;
+        for (uint32_t i = 0; i < size; i++) {
+            if (i)
+                out << " ";
+            if (values[i] == UNREACHED)
+                out << "-1";
+            else
+                out << values[i];
+        }
+        out << std::endl;
+    }
+}
+
+std::shared_ptr<Lookahead>
+Lookahead::load(std::shared_ptr<const CompiledGraph> graph,
+                const std::string &filename) {
+    std::ifstream in(filename);
+    if (!graph || !in.good())
+        return nullptr;
+    auto const &g = *graph;
+
+    std::string token;
+    uint32_t version;
+    if (!(in >> token >> version) || token != LOOKAHEAD || version != VERSION)
+        return nullptr;
+    uint32_t size, num_edges, width, height, num_rows;
+    if (!(in >> token >> size >> num_edges >> width >> height >> num_rows) ||
+        token != GRAPH)
+        return nullptr;
+    // make sure it's profiled from the same graph
+    if (size != g.size() || num_edges != g.num_edges() ||
+        width != g.width() || height != g.height())
+        return nullptr;
+
+    auto result = shared_ptr<Lookahead>(new Lookahead());
+    result->graph_ = std::move(graph);
+    result->span_x_ = width > 0 ? 2 * width - 1 : 0;
+    result->span_y_ = height > 0 ? 2 * height - 1 : 0;
+    auto const row_size = result->row_size();
+    result->values_.reserve(static_cast<uint64_t>(num_rows) * row_size);
+
+    map<SourceClass, uint32_t> row_ids;
+    std::string line;
+    for (uint32_t row = 0; row < num_rows; row++) {
+        uint32_t switch_id, type, track, side, io;
+        if (!(in >> token >> switch_id >> type >> track >> side >> io) ||
+            token != ROW)
+            return nullptr;
+        SourceClass source_class = {switch_id, type, track, side, io};
+        result->rows_.emplace_back(source_class);
+        row_ids.emplace(source_class, row);
+        // the values are on a single line. parse it directly since the
+        // stream extraction is fairly slow for tables this size
+        std::getline(in >> std::ws, line);
+        auto const *pos = line.c_str();
+        for (uint32_t i = 0; i < row_size; i++) {
+            char *end;
+            auto const value = std::strtol(pos, &end, 10);
+            if (end == pos)
+                return nullptr;
+            pos = end;
+            result->values_.emplace_back(value < 0 ? UNREACHED : static_cast<uint32_t>(value));
+        }
+    }
+    result->index_nodes(row_ids);
+    result->compute_tile_cost();
+    return result;
+}
@@ -0,0 +1,77 @@
+#ifndef CYCLONE_LOOKAHEAD_HH
+#define CYCLONE_LOOKAHEAD_HH
+
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "graph.hh"
+
+// precomputed routing lookahead used as the A* heuristic.
+// the table is indexed by the source class (template, node type, track,
+// side, io), the offset (dx, dy) and the sink node type. every entry is the
+// minimum edge cost to a sink of the type at the offset over all the nodes
+// of the class in the fabric. it's computed with one backward search from
+// the nodes of every type in every tile, so no tile is left out. since
+// every other routing cost is added on top of the edge cost, an entry is a
+// lower bound of the actual routing cost of any node of the class.
+// Note:
+// offsets that no node of the class can reach, and nodes the table doesn't
+// cover, fall back to the manhattan distance times the lowest cost per tile
+// of any edge between tiles, which is a lower bound as well
+class Lookahead {
+public:
+    explicit Lookahead(std::shared_ptr<const CompiledGraph> graph);
+
+    // estimated cost from the node to the sink node
+    uint32_t estimate(uint32_t node, uint32_t sink) const;
+    // estimated cost from the node to any node of given type at pos
+    uint32_t estimate(uint32_t node, const std::pair<uint32_t, uint32_t> &pos,
+                      NodeType sink_type) const;
+
+    const std::shared_ptr<const CompiledGraph> &get_graph() const
+    { return graph_; }
+    uint32_t num_rows() const { return static_cast<uint32_t>(rows_.size()); }
+
+    // the tables are only valid for the graph they are profiled from.
+    // load returns nullptr if the file does not exist or does not match the
+    // graph
+    void dump(const std::string &filename) const;
+    static std::shared_ptr<Lookahead>
+    load(std::shared_ptr<const CompiledGraph> graph,
+         const std::string &filename);
+
+private:
+    // switch id, node type, track, side, io
+    using SourceClass = std::tuple<uint32_t, uint32_t, uint32_t, uint32_t,
+                                   uint32_t>;
+    static constexpr uint32_t NUM_SINK_TYPES = NodeType::Generic + 1;
+    static constexpr uint32_t UNREACHED = 0xFFFFFFFF;
+    static constexpr uint32_t NO_ROW = 0xFFFFFFFF;
+
+    std::shared_ptr<const CompiledGraph> graph_;
+
+    // one row per source class, each holding a dense
+    // (2 * width - 1) x (2 * height - 1) x NUM_SINK_TYPES table
+    std::vector<SourceClass> rows_;
+    std::vector<uint32_t> values_;
+    // row index of every node in the graph
+    std::vector<uint32_t> node_row_;
+    uint32_t span_x_ = 0;
+    uint32_t span_y_ = 0;
+    // lowest edge cost per tile crossed, see the note above
+    double tile_cost_ = 0;
+
+    // used by load()
+    Lookahead() = default;
+
+    SourceClass get_source_class(uint32_t node) const;
+    uint32_t row_size() const { return span_x_ * span_y_ * NUM_SINK_TYPES; }
+    uint32_t index(uint32_t row, int dx, int dy, uint32_t sink_type) const;
+    void index_nodes(const std::map<SourceClass, uint32_t> &row_ids);
+    void compute_tile_cost();
+    void profile();
+};
+
+#endif //CYCLONE_LOOKAHEAD_HH
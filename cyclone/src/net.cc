@@ -17,12 +17,14 @@ Net::Net(const std::string &name,
 void Net::add_pin(const Pin &pin) {
     pins_.emplace_back(pin);
     pins_.back().id = static_cast<uint32_t>(pins_.size() - 1);
+    pin_order_.clear();
 }
 
 void Net::remove_pin(const uint32_t &pin_id) {
     pins_.erase(pins_.begin() + pin_id);
     for (uint32_t i = 0; i < pins_.size(); i++) 
         pins_[i].id = i;
+    pin_order_.clear();
 }
 
 Pin::Pin(uint32_t x, uint32_t y, const std::string &name,
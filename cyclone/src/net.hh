@@ -4,6 +4,7 @@
 #include <vector>
 #include <memory>
 #include <string>
+#include <utility>
 
 
 struct Node;
@@ -42,8 +43,18 @@ public:
     inline const Pin& operator[](const uint64_t &index) const
     { return pins_[index]; }
 
+    // sink indices in routing order, empty if not computed yet. it is set by
+    // the router and kept across iterations since pin locations do not
+    // change while routing. adding or removing pins clears it, so does
+    // clear_pin_order() when the pin locations are changed
+    const std::vector<uint32_t> &pin_order() const { return pin_order_; }
+    void set_pin_order(std::vector<uint32_t> order)
+    { pin_order_ = std::move(order); }
+    void clear_pin_order() { pin_order_.clear(); }
+
 private:
     std::vector<Pin> pins_;
+    std::vector<uint32_t> pin_order_;
 };
 
 
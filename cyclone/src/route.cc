@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <string>
 #include <cmath>
+#include <limits>
 #include <unordered_set>
 #include "route.hh"
 #include "util.hh"
@@ -21,42 +22,56 @@ using std::unordered_map;
 using std::unordered_set;
 
 
-uint64_t Router::net_id_count_ = 0;
+std::atomic<uint64_t> Router::net_id_count_ = 0;
 
-Router::Router(const RoutingGraph &g) : graph_(g) {
-    // create the look up table for cost analysis
-    for (const auto &tile_iter : graph_) {
-        const auto &tile = tile_iter.second;
-        for (uint32_t side = 0; side < Switch::SIDES; side++) {
-            auto &side_sbs = tile.switchbox.get_sbs_by_side(get_side_int(side));
-            for (const auto &sb : side_sbs) {
-                node_connections_.insert({sb, {}});
-                node_history_.insert({sb, {}});
-                node_net_ids_.insert({sb, {}});
-            }
-        }
-        for (auto const &port : tile.ports) {
-            node_connections_.insert({port.second, {}});
-            node_history_.insert({port.second, {}});
-            node_net_ids_.insert({port.second, {}});
-        }
-        for (auto const &reg : tile.registers) {
-            node_connections_.insert({reg.second, {}});
-            node_history_.insert({reg.second, {}});
-            node_net_ids_.insert({reg.second, {}});
-        }
-        for (auto const &reg_mux: tile.rmux_nodes) {
-            node_connections_.insert({reg_mux.second, {}});
-            node_history_.insert({reg_mux.second, {}});
-            node_net_ids_.insert({reg_mux.second, {}});
-        }
+SearchWorkspace &SearchWorkspace::get() {
+    static thread_local SearchWorkspace workspace;
+    return workspace;
+}
+
+void SearchWorkspace::reset(uint32_t num_states) {
+    if (g_score_.size() < num_states) {
+        g_score_.resize(num_states, 0);
+        f_score_.resize(num_states, 0);
+        trace_.resize(num_states, 0);
+        path_signature_.resize(num_states, 0);
+        visit_gen_.resize(num_states, 0);
+    }
+    open_list.reserve(num_states);
+    next_generation();
+    open_list.clear();
+}
+
+void SearchWorkspace::next_generation() {
+    if (gen_ == std::numeric_limits<uint32_t>::max()) {
+        // wrapped around. every entry has to be invalidated explicitly
+        std::fill(visit_gen_.begin(), visit_gen_.end(), 0);
+        gen_ = 0;
     }
+    gen_++;
+}
+
+Router::Router(const RoutingGraph &g)
+    : Router(std::make_shared<const CompiledGraph>(g)) {}
+
+Router::Router(std::shared_ptr<const CompiledGraph> graph)
+    : graph_(std::move(graph)) {
+    // create the look up table for cost analysis
+    auto const num_nodes = graph_->size();
+    node_connections_.resize(num_nodes);
+    overused_pos_.resize(num_nodes, NOT_OVERUSED);
+    node_net_ids_.resize(num_nodes);
+    node_history_.resize(num_nodes, 0);
+    node_delay_.resize(num_nodes);
+    for (uint32_t id = 0; id < num_nodes; id++)
+        node_delay_[id] = graph_->delay(id);
 }
 
 void
 Router::add_net(const ::string &name,
                 const ::vector<::pair<::string, ::string>> &net) {
-    int net_id = static_cast<int>(net_id_count_++);
+    int net_id = next_net_id_ ? (*next_net_id_)++
+                              : static_cast<int>(net_id_count_++);
     Net n;
     n.id = net_id;
     n.name = name;
@@ -165,126 +180,63 @@ std::vector<std::shared_ptr<Node>> Router::route_a_star(
                                const std::shared_ptr<Node> &)> cost_f,
         std::function<double(const ::shared_ptr<Node> &)> h_f,
         int req_regs) {
-            
-    ::unordered_set<::shared_ptr<Node>> visited;
-    ::unordered_map<::shared_ptr<Node>, double> g_score = {{start, 0}};
-
-    ::unordered_map<::shared_ptr<Node>, double> f_score = {{start,
-                                                            h_f(start)}};
-    // use cost as a comparator
-    auto cost_comp = [&](const ::shared_ptr<Node> &a,
-                         const ::shared_ptr<Node> &b) -> bool {
-        return f_score.at(a) > f_score.at(b);
-    };
-
-    ::set<::pair<::shared_ptr<Node>, ::shared_ptr<Node>>> blockages;
-
-    ::priority_queue<::shared_ptr<Node>,
-            ::vector<::shared_ptr<Node>>,
-            decltype(cost_comp)> working_set(cost_comp);
-    working_set.push(start);
-    ::unordered_set<::shared_ptr<Node>> open_set;
-    open_set.insert(start);
-
-    ::map<::shared_ptr<Node>, ::shared_ptr<Node>> trace;
-    ::vector<::shared_ptr<Node>> routed_path;
-
-    ::shared_ptr<Node> head = nullptr;
-
-    while (!working_set.empty()) {
-
-        // get the one with lowest cost
-        head = working_set.top();
-
-        if (end_f(head)) {
-            routed_path.clear();
-            auto head_t = head;
-
-            int avail_regs = 0;
-            while (head_t != start) {
-                routed_path.emplace_back(head_t);
-                if (head_t->type == NodeType::Generic and trace.at(head_t)->type == NodeType::SwitchBox)
-                    avail_regs++;
-                head_t = trace.at(head_t);
-            }
-            routed_path.emplace_back(head_t);
-
-            if (avail_regs < req_regs) {
-                // Add blockage
-                int blockage_idx = (routed_path.size() / 2);
-                if (routed_path[blockage_idx-1]->type == NodeType::Register && (blockage_idx + 1) < int(routed_path.size()))
-                    blockage_idx++;
-
-                blockages.emplace(std::make_pair(routed_path[blockage_idx], routed_path[blockage_idx-1]));
-                
-                // Reset everything and retry
-                while (!working_set.empty()) {
-                    working_set.pop();
-                }
-                working_set.push(start);
-                open_set = {};
-                open_set.insert(start);
-                visited = {};
-                trace.clear();
-                continue;
-            } else {
-                break;
-            }       
-        }
-
-        working_set.pop();
-        open_set.erase(head);
-
-        if (visited.find(head) != visited.end())
-            continue;
-
-        visited.insert(head);
+    auto const &g = *graph_;
+    auto path = route_a_star(g.get_id(start),
+                             [&](uint32_t id) -> bool {
+                                 return end_f(g.get_node(id));
+                             },
+                             [&](uint32_t id,
+                                 const CompiledGraph::Edge &edge) -> double {
+                                 return cost_f(g.get_node(id),
+                                               g.get_node(edge.node));
+                             },
+                             [&](uint32_t id) -> double {
+                                 return h_f(g.get_node(id));
+                             },
+                             req_regs);
+    return g.get_nodes(path);
+}
 
-        for (auto const &node : *head) {
-            if (blockages.find(std::make_pair(head, node.lock())) != blockages.end()) 
-                continue;
-            
+std::vector<uint32_t>
+Router::route_a_star(uint32_t start,
+                     const std::function<bool(uint32_t)> &end_f,
+                     const std::function<double(uint32_t,
+                                                const CompiledGraph::Edge &)>
+                                                &cost_f,
+                     const std::function<double(uint32_t)> &h_f,
+                     int req_regs) {
+    return route_a_star<std::function<bool(uint32_t)>,
+                        std::function<double(uint32_t,
+                                             const CompiledGraph::Edge &)>,
+                        std::function<double(uint32_t)>>(start, end_f, cost_f,
+                                                         h_f, req_regs);
+}
 
-            if (visited.find(node.lock()) != visited.end())
-                continue;
-
-            double tentative_score = g_score.at(head)
-                                     + head->get_edge_cost(node.lock())
-                                     + cost_f(head, node.lock());
-
-            if (open_set.find(node.lock()) == open_set.end()) {
-                g_score[node.lock()] = tentative_score;
-                f_score[node.lock()] = g_score.at(node.lock())
-                                       + h_f(node.lock());
-                working_set.push(node.lock());
-                open_set.insert(node.lock());
-            } else if (g_score.find(node.lock()) != g_score.end() &&
-                       tentative_score >= g_score.at(node.lock())) {
-                continue;
-            } else {
-                g_score[node.lock()] = tentative_score;
-                f_score[node.lock()] = g_score.at(node.lock())
-                                       + h_f(node.lock());
-                // a duplicated copy
-                working_set.push(node.lock());
-            }
-            trace.insert({node.lock(), head});
-        }
+std::shared_ptr<Node> Router::get_port(const uint32_t &x, const uint32_t &y,
+                                       const string &port) {
+    return graph_->get_port(x, y, port);
+}
 
-    }
+void Router::set_lookahead(std::shared_ptr<const Lookahead> lookahead) {
+    if (lookahead && lookahead->get_graph() != graph_)
+        throw ::runtime_error("lookahead is not built from the routing graph");
+    lookahead_ = std::move(lookahead);
+}
 
-    if (!end_f(head)) {
-        throw UnableRouteException("unable to route from "
-                                   + start->to_string() + " req_regs " + std::to_string(req_regs));
-    }
+Router::Heuristic Router::get_heuristic(uint32_t end) const {
+    auto const &g = *graph_;
+    return {graph_.get(), lookahead_.get(), {g.x(end), g.y(end)}, g.type(end)};
+}
 
-    std::reverse(routed_path.begin(), routed_path.end());
-    return routed_path;
+Router::Heuristic
+Router::get_heuristic(const std::pair<uint32_t, uint32_t> &pos,
+                      NodeType type) const {
+    return {graph_.get(), lookahead_.get(), pos, type};
 }
 
-std::shared_ptr<Node> Router::get_port(const uint32_t &x, const uint32_t &y,
-                                       const string &port) {
-    return graph_.get_port(x, y, port);
+void Router::set_node_delay(const std::shared_ptr<Node> &node,
+                            uint32_t delay) {
+    node_delay_[graph_->get_id(node)] = delay;
 }
 
 void Router::group_reg_nets() {
@@ -456,28 +408,52 @@ Router::reorder_reg_nets() {
 }
 
 bool Router::overflow() {
-    return overflowed_;
+    return !overused_nodes_.empty();
+}
+
+uint32_t Router::get_total_overuse() const {
+    uint32_t result = 0;
+    for (auto const node : overused_nodes_)
+        result += node_connections_[node].size() - 1;
+    return result;
+}
+
+std::set<int> Router::get_congested_nets() const {
+    ::set<int> result;
+    for (auto const node : overused_nodes_) {
+        for (auto const net_id : node_net_ids_[node])
+            result.emplace(net_id);
+    }
+    return result;
 }
 
 void Router::assign_net_segment(const ::vector<::shared_ptr<Node>> &segment,
                                 int net_id) {
+    ::vector<NodeHandle> handles;
+    handles.reserve(segment.size());
+    for (auto const &node : segment)
+        handles.emplace_back(node.get());
+    assign_net_segment(handles, net_id);
+}
+
+void Router::assign_net_segment(const ::vector<NodeHandle> &segment,
+                                int net_id) {
     for (uint32_t i = 1; i < segment.size(); i++) {
         auto &node = segment[i];
-        assign_connection(node, segment[i - 1]);
+        assign_connection(node->id, segment[i - 1]->id);
     }
     for (const auto &node : segment) {
-        node_net_ids_[node].insert(net_id);
+        node_net_ids_[node->id].insert(net_id);
     }
 }
 
 void Router::assign_history() {
     for (const auto &[net_id, net] : netlist_) {
-        auto segments = current_routes[net.id];
+        auto const &segments = current_routes[net.id];
         for (auto &seg_it : segments) {
             auto &segment = seg_it.second;
-            for (uint32_t i = 0; i < segment.size(); i++) {
-                auto &node = segment[i];
-                assign_history(node);
+            for (auto const &node : segment) {
+                assign_history(node->id);
             }
         }
     }
@@ -494,7 +470,7 @@ Router::realize() const {
         // realize them in the pin order
         for (uint32_t seg_index = 1; seg_index< net.size(); seg_index++) {
             auto const &seg = route.at(net[seg_index].id);
-            segments.emplace_back(seg);
+            segments.emplace_back(graph_->get_nodes(seg));
         }
         result.insert({name, segments});
     }
@@ -504,61 +480,58 @@ Router::realize() const {
 void Router::rip_up_net(int net_id) {
     if (current_routes.find(net_id) == current_routes.end())
         return;
-    auto const &route = current_routes.at(net_id);
+    rip_up_segments(net_id);
+    // remove it from current_routes
+    current_routes.erase(net_id);
+}
+
+void Router::rip_up_segments(int net_id) {
+    auto &route = current_routes.at(net_id);
     for (const auto &segment : route) {
-        auto nodes = segment.second;
+        auto const &nodes = segment.second;
         // remove it from the presence cost
         for (uint32_t i = 1; i < nodes.size(); i++) {
             auto const &node = nodes[i];
             auto const &pre_node = nodes[i - 1];
-            node_connections_.at(node).erase(pre_node);
+            remove_connection(node->id, pre_node->id);
         }
         // also remove it from node_net_ids;
         for (const auto &node : nodes) {
-            auto &lst = node_net_ids_.at(node);
-            if (lst.find(net_id) != lst.end())
-                lst.erase(net_id);
+            node_net_ids_[node->id].erase(net_id);
         }
     }
-    // remove it from current_routes
-    current_routes.erase(net_id);
-}
-
-
-bool Router::node_owned_net(int net_id, std::shared_ptr<Node> node) {
-    if (node_net_ids_.at(node).empty()) {
-        return true;
-    }
-    if (node_net_ids_.at(node).size() == 1) {
-        return net_id == *node_net_ids_.at(node).begin();
-    }
-    return false;
+    route.clear();
 }
 
-void Router::assign_connection(const std::shared_ptr<Node> &node,
-                               const std::shared_ptr<Node> &pre_node) {
-    node_connections_.at(node).insert(pre_node);
-    if (!overflowed_ && node_connections_[node].size() > 1)
-        overflowed_ = true;
 
+void Router::assign_connection(uint32_t node, uint32_t pre_node) {
+    auto &drivers = node_connections_[node];
+    // a node becomes overused with its second driver
+    if (drivers.insert(pre_node) && drivers.size() == 2)
+        add_overused(node);
 }
 
-void Router::assign_history(std::shared_ptr<Node> &end) {
-    node_history_.at(end)++;
+void Router::remove_connection(uint32_t node, uint32_t pre_node) {
+    auto &drivers = node_connections_[node];
+    if (drivers.erase(pre_node) && drivers.size() == 1)
+        remove_overused(node);
 }
 
-uint32_t Router::get_history_cost(const std::shared_ptr<Node> &node) {
-    uint32_t result = node_history_.at(node);
-    return result;
+void Router::add_overused(uint32_t node) {
+    std::lock_guard<std::mutex> guard(overused_mutex_);
+    overused_pos_[node] = static_cast<uint32_t>(overused_nodes_.size());
+    overused_nodes_.emplace_back(node);
 }
 
-double Router::get_presence_cost(const std::shared_ptr<Node> &node,
-                                 const std::shared_ptr<Node> &pre_node) {
-    auto const &start_connection = node_connections_.at(node);
-    if (start_connection.find(pre_node) == start_connection.end())
-        return start_connection.size();
-    else
-        return (start_connection.size() - 1);
+void Router::remove_overused(uint32_t node) {
+    std::lock_guard<std::mutex> guard(overused_mutex_);
+    // move the last one into its place
+    auto const pos = overused_pos_[node];
+    auto const last = overused_nodes_.back();
+    overused_nodes_[pos] = last;
+    overused_pos_[last] = pos;
+    overused_nodes_.pop_back();
+    overused_pos_[node] = NOT_OVERUSED;
 }
 
 
@@ -576,7 +549,7 @@ std::unordered_map<int, RoutedGraph> Router::get_routed_graph() const {
         std::map<const Pin*, std::vector<std::shared_ptr<Node>>> route;
         auto const &net = netlist_.at(net_id);
         for (auto const &[index, seg]: segments) {
-            route.emplace(&net[index], seg);
+            route.emplace(&net[index], graph_->get_nodes(seg));
         }
         result.emplace(net_id, RoutedGraph(route));
     }
@@ -584,9 +557,23 @@ std::unordered_map<int, RoutedGraph> Router::get_routed_graph() const {
     return result;
 }
 
+void Router::set_current_routes(
+        const ::map<int, ::map<uint32_t, ::vector<::shared_ptr<Node>>>> &routes) {
+    current_routes.clear();
+    for (auto const &[net_id, segments] : routes) {
+        auto &route = current_routes[net_id];
+        for (auto const &[pin_id, segment] : segments)
+            route.emplace(pin_id, graph_->get_handles(graph_->get_ids(segment)));
+    }
+}
+
 void Router::update_net_route(int net_id, std::map<uint32_t, std::vector<std::shared_ptr<Node>>> &routes) {
-    if (current_routes.find(net_id) != current_routes.end()) {
-        current_routes[net_id] = routes;
+    auto iter = current_routes.find(net_id);
+    if (iter != current_routes.end()) {
+        iter->second.clear();
+        for (auto const &[pin_id, segment] : routes)
+            iter->second.emplace(pin_id,
+                                 graph_->get_handles(graph_->get_ids(segment)));
     }
 }
 
@@ -1,17 +1,174 @@
 #ifndef CYCLONE_ROUTE_HH
 #define CYCLONE_ROUTE_HH
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <functional>
 #include <map>
+#include <mutex>
+#include <optional>
+#include <set>
 #include <unordered_map>
 #include "graph.hh"
+#include "heap.hh"
+#include "lookahead.hh"
 #include "net.hh"
 
+// small set that keeps up to N entries inline and only spills to the heap
+// when it grows beyond that. used for the per-node router tables, where most
+// of the entries hold zero or one element
+template <typename T, uint32_t N>
+class InlineSet {
+public:
+    uint32_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    const T *begin() const { return data(); }
+    const T *end() const { return data() + size_; }
+    const T &front() const { return *data(); }
+
+    bool contains(const T &value) const
+    { return std::find(begin(), end(), value) != end(); }
+
+    bool insert(const T &value) {
+        if (contains(value))
+            return false;
+        if (size_ < N) {
+            inline_[size_] = value;
+        } else {
+            if (size_ == N)
+                overflow_.assign(inline_.begin(), inline_.end());
+            overflow_.emplace_back(value);
+        }
+        size_++;
+        return true;
+    }
+
+    bool erase(const T &value) {
+        T *values = data();
+        auto pos = std::find(values, values + size_, value);
+        if (pos == values + size_)
+            return false;
+        // order is not preserved
+        *pos = values[size_ - 1];
+        size_--;
+        if (size_ >= N) {
+            overflow_.pop_back();
+            if (size_ == N) {
+                std::copy(overflow_.begin(), overflow_.end(), inline_.begin());
+                overflow_.clear();
+            }
+        }
+        return true;
+    }
+
+private:
+    uint32_t size_ = 0;
+    std::array<T, N> inline_ = {};
+    std::vector<T> overflow_;
+
+    T *data() { return size_ > N ? overflow_.data() : inline_.data(); }
+    const T *data() const
+    { return size_ > N ? overflow_.data() : inline_.data(); }
+};
+
+// search region in tiles, bounds included
+struct BoundingBox {
+    uint32_t xmin = 0;
+    uint32_t ymin = 0;
+    uint32_t xmax = 0;
+    uint32_t ymax = 0;
+
+    bool contains(uint32_t x, uint32_t y) const
+    { return x >= xmin && x <= xmax && y >= ymin && y <= ymax; }
+    bool contains(const BoundingBox &box) const
+    { return contains(box.xmin, box.ymin) && contains(box.xmax, box.ymax); }
+};
+
+// search region given as a set of tiles, e.g. the corridor assigned by the
+// coarse router. tiles outside of the grid are not in it
+struct TileMask {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<bool> tiles;
+
+    TileMask() = default;
+    TileMask(uint32_t width, uint32_t height)
+        : width(width), height(height),
+          tiles(static_cast<uint64_t>(width) * height, false) {}
+
+    bool contains(uint32_t x, uint32_t y) const
+    { return x < width && y < height && tiles[index(x, y)]; }
+    void add(uint32_t x, uint32_t y)
+    { if (x < width && y < height) tiles[index(x, y)] = true; }
+
+private:
+    uint64_t index(uint32_t x, uint32_t y) const
+    { return static_cast<uint64_t>(y) * width + x; }
+};
+
+// scratch space of the A* search. the tables are indexed by search state and
+// the visited flags are tagged with a generation counter, so starting a new
+// search is O(1) and a search does not allocate once the tables have grown
+// to the graph size.
+// one workspace is kept per thread, see get()
+class SearchWorkspace {
+public:
+    static SearchWorkspace &get();
+
+    // start a new search over num_states search states. the states are
+    // node ids unless the search tracks extra labels
+    void reset(uint32_t num_states);
+
+    // scores are only meaningful for the nodes reached by the search
+    double g_score(uint32_t node) const { return g_score_[node]; }
+    double f_score(uint32_t node) const { return f_score_[node]; }
+    void set_score(uint32_t node, double g, double f) {
+        g_score_[node] = g;
+        f_score_[node] = f;
+    }
+
+    bool visited(uint32_t node) const { return visit_gen_[node] == gen_; }
+    void visit(uint32_t node) { visit_gen_[node] = gen_; }
+
+    // predecessor on the best path found so far
+    uint32_t trace(uint32_t node) const { return trace_[node]; }
+    void set_trace(uint32_t node, uint32_t pre_node)
+    { trace_[node] = pre_node; }
+
+    // 64 bit signature of the nodes on the best path found so far. a node
+    // whose bit is not set is not on the path. only kept up to date by the
+    // searches that track labels
+    uint64_t path_signature(uint32_t node) const
+    { return path_signature_[node]; }
+    void set_path_signature(uint32_t node, uint64_t signature)
+    { path_signature_[node] = signature; }
+    static uint64_t signature_bit(uint32_t node)
+    { return uint64_t(1) << ((node * 0x9E3779B97F4A7C15ull) >> 58u); }
+
+    // open list keyed by the f score. it's cleared on reset
+    IndexedHeap<double> open_list;
+
+private:
+    uint32_t gen_ = 0;
+
+    std::vector<double> g_score_;
+    std::vector<double> f_score_;
+    std::vector<uint32_t> trace_;
+    std::vector<uint64_t> path_signature_;
+    std::vector<uint32_t> visit_gen_;
+
+    void next_generation();
+};
+
 // base class for global and detailed routers
 // implement basic routing algorithms and IO handling
 class Router {
 public:
     explicit Router(const RoutingGraph &g);
+    // routers constructed from the same graph share it. everything that
+    // changes during routing is kept in the router
+    explicit Router(std::shared_ptr<const CompiledGraph> graph);
 
     // add_net has to be used after constructing all the routing graph
     // otherwise it will throw errors
@@ -20,6 +177,14 @@ public:
     void add_placement(const uint32_t &x, const uint32_t &y,
                        const std::string &blk_id);
     bool overflow();
+    // nodes with more than one driver, in no particular order. they are kept
+    // up to date as connections are assigned and ripped up
+    const std::vector<uint32_t> &get_overused_nodes() const
+    { return overused_nodes_; }
+    // total number of extra drivers on the overused nodes
+    uint32_t get_total_overuse() const;
+    // nets that use any overused node
+    std::set<int> get_congested_nets() const;
 
     // routing related function
     virtual void route() { };
@@ -35,40 +200,79 @@ public:
     void set_init_pn(double init_pn) { init_pn_ = init_pn; }
     double get_pn_factor() const  { return pn_factor_; }
     void set_pn_factor(double pn_factor) { pn_factor_ = pn_factor; }
+    // overrides the node delay for this router only, e.g. power domain cost
+    void set_node_delay(const std::shared_ptr<Node> &node, uint32_t delay);
+    uint32_t get_node_delay(const std::shared_ptr<Node> &node) const
+    { return node_delay_[graph_->get_id(node)]; }
+    const std::shared_ptr<const CompiledGraph> &get_graph() const
+    { return graph_; }
+    // use the lookahead tables as A* heuristic. it has to be profiled from
+    // the same graph. set it to nullptr to use manhattan distance instead
+    void set_lookahead(std::shared_ptr<const Lookahead> lookahead);
+    const std::shared_ptr<const Lookahead> &get_lookahead() const
+    { return lookahead_; }
     const std::map<int, Net>& get_netlist() const { return netlist_; }
+    // number of nodes expanded by the searches, in total and by the last one
+    uint64_t get_nodes_expanded() const { return nodes_expanded_; }
+    uint64_t get_last_nodes_expanded() const { return last_nodes_expanded_; }
+    // number of searches run and open list insertions, in total
+    uint64_t get_num_searches() const { return num_searches_; }
+    uint64_t get_heap_pushes() const { return heap_pushes_; }
     [[nodiscard]] bool has_net(int net_id) const;
+    // by default net ids are taken from a counter shared by all the routers
+    // so that they don't conflict when the netlist is shared. with a base,
+    // the router numbers its nets base, base + 1, ... instead, which does not
+    // depend on the order routers add their nets in. it has to be set before
+    // add_net
+    void set_net_id_base(int base) { next_net_id_ = base; }
 
     // get final routed graph
     std::unordered_map<int, RoutedGraph> get_routed_graph() const;
 
     void set_current_routes(const std::map<int,
             std::map<uint32_t,
-                    std::vector<std::shared_ptr<Node>>>> &routes) { current_routes = routes; }
+                    std::vector<std::shared_ptr<Node>>>> &routes);
 
     void update_net_route(int net_id, std::map<uint32_t, std::vector<std::shared_ptr<Node>>> &routes);
 
     virtual ~Router() = default;
 
 protected:
-    RoutingGraph graph_;
+    // read-only CSR form of the routing graph. all the searches run on it
+    std::shared_ptr<const CompiledGraph> graph_;
+    std::shared_ptr<const Lookahead> lookahead_;
     std::map<int, Net> netlist_;
     std::map<std::string, std::pair<uint32_t, uint32_t>> placement_;
     std::map<int, std::vector<int>> reg_net_order_;
     std::map<int, int> needed_regs_;
     std::map<std::string, int> reg_net_src_;
-    // a list of routing segments indexed by net id
+    // a list of routing segments indexed by net id. the nodes are owned by
+    // the graph, so the segments only hold handles
     std::map<int,
             std::map<uint32_t,
-                    std::vector<std::shared_ptr<Node>>>> current_routes;
-
-    // graph independent look tables for computing routing cost
-    std::map<std::shared_ptr<Node>, std::set<std::shared_ptr<Node>>>
-    node_connections_;
-    std::unordered_map<std::shared_ptr<Node>, std::set<int>> node_net_ids_;
-
-    std::map<std::shared_ptr<Node>, uint32_t> node_history_;
-
-    bool overflowed_ = false;
+                    std::vector<NodeHandle>>> current_routes;
+
+    // graph independent look tables for computing routing cost. they are
+    // indexed by node id. the occupancy of a node is the number of drivers
+    std::vector<InlineSet<uint32_t, 2>> node_connections_;
+    std::vector<InlineSet<int, 2>> node_net_ids_;
+
+    std::vector<uint32_t> node_history_;
+    // per-router node delay, initialized from the graph
+    std::vector<uint32_t> node_delay_;
+
+    // overused nodes and their position in the list, indexed by node id.
+    // nets may be routed concurrently, see GlobalRouter::num_threads, so the
+    // list is locked. it's only touched when a node gets its second driver
+    // or loses it
+    std::vector<uint32_t> overused_nodes_;
+    std::vector<uint32_t> overused_pos_;
+    std::mutex overused_mutex_;
+
+    std::atomic<uint64_t> nodes_expanded_ = 0;
+    std::atomic<uint64_t> last_nodes_expanded_ = 0;
+    std::atomic<uint64_t> heap_pushes_ = 0;
+    std::atomic<uint64_t> num_searches_ = 0;
 
     const static uint32_t IN = 0;
     const static uint32_t OUT = 1;
@@ -95,7 +299,6 @@ protected:
                                       const std::shared_ptr<Node> &)> cost_f,
                                                                 int req_regs);
 
-
     std::vector<std::shared_ptr<Node>>
     route_a_star(const std::shared_ptr<Node> &start,
                  const std::pair<uint32_t, uint32_t> &end,
@@ -124,8 +327,6 @@ protected:
                                       const std::shared_ptr<Node> &)> cost_f,
                  std::function<double(const std::shared_ptr<Node> &)> h_f);
 
-    // this is the actual routing engine shared by Dijkstra and A*
-    // it's designed to be flexible
     std::vector<std::shared_ptr<Node>>
     route_a_star(const std::shared_ptr<Node> &start,
                  std::function<bool(const std::shared_ptr<Node> &)> end_f,
@@ -134,7 +335,77 @@ protected:
                  std::function<double(const std::shared_ptr<Node> &)> h_f,
                  int req_regs);
 
+    // this is the actual routing engine shared by Dijkstra and A*
+    // it works on the node ids of the compiled graph and takes the goal,
+    // cost and heuristic as policies, see SameNode, DelayCost and Heuristic
+    // for the interface. cost_f gets the edge being taken so that it can use
+    // the edge cost without looking it up again.
+    // the node-based versions above are thin wrappers around it.
+    // if box is set, nodes outside of it are not explored, and the same for
+    // the tiles outside of mask
+    template <typename EndF, typename CostF, typename HeuristicF>
+    std::vector<uint32_t>
+    route_a_star(uint32_t start, const EndF &end_f, const CostF &cost_f,
+                 const HeuristicF &h_f, int req_regs,
+                 const BoundingBox *box = nullptr,
+                 const TileMask *mask = nullptr);
+    // multi-source version. the search starts from every (node, cost) seed
+    // at once, e.g. every node of a partially routed net, and the returned
+    // path starts at whichever seed the goal is reached from
+    template <typename EndF, typename CostF, typename HeuristicF>
+    std::vector<uint32_t>
+    route_a_star(const std::vector<std::pair<uint32_t, double>> &seeds,
+                 const EndF &end_f, const CostF &cost_f,
+                 const HeuristicF &h_f, int req_regs,
+                 const BoundingBox *box = nullptr,
+                 const TileMask *mask = nullptr);
+
+    // type-erased version, for the python binding and compatibility
+    std::vector<uint32_t>
+    route_a_star(uint32_t start,
+                 const std::function<bool(uint32_t)> &end_f,
+                 const std::function<double(uint32_t,
+                                            const CompiledGraph::Edge &)>
+                                            &cost_f,
+                 const std::function<double(uint32_t)> &h_f,
+                 int req_regs);
 
+    // search policies. they are plain functors so that the calls can be
+    // inlined into the search core
+    // goal: the given node
+    struct SameNode {
+        uint32_t node;
+        bool operator()(uint32_t id) const { return id == node; }
+    };
+    // goal: any node at the given location
+    struct SameLoc {
+        const CompiledGraph *graph;
+        std::pair<uint32_t, uint32_t> pos;
+        bool operator()(uint32_t id) const
+        { return graph->x(id) == pos.first && graph->y(id) == pos.second; }
+    };
+    // cost: the edge cost, i.e. delay, only. nothing is added on top
+    struct DelayCost {
+        double operator()(uint32_t, const CompiledGraph::Edge &) const
+        { return 0; }
+    };
+    // heuristic: lookahead tables if available, manhattan distance otherwise
+    struct Heuristic {
+        const CompiledGraph *graph;
+        const Lookahead *lookahead;
+        std::pair<uint32_t, uint32_t> pos;
+        NodeType type;
+        double operator()(uint32_t id) const {
+            return lookahead ? lookahead->estimate(id, pos, type)
+                             : graph->manhattan_distance(id, pos);
+        }
+    };
+
+    // A* heuristics towards the sink node, or any node of the given type at
+    // pos
+    Heuristic get_heuristic(uint32_t end) const;
+    Heuristic get_heuristic(const std::pair<uint32_t, uint32_t> &pos,
+                            NodeType type) const;
 
     std::shared_ptr<Node> get_port(const uint32_t &x,
                                    const uint32_t &y,
@@ -146,23 +417,43 @@ protected:
     void squash_non_broadcast_reg_nets();
     std::vector<uint32_t> reorder_reg_nets();
 
+    void assign_net_segment(const std::vector<NodeHandle> &segment,
+                            int net_id);
+    void assign_connection(uint32_t node, uint32_t pre_node);
+    void remove_connection(uint32_t node, uint32_t pre_node);
+    void assign_history(uint32_t node) { node_history_[node]++; }
 
-    void assign_connection(const std::shared_ptr<Node> &node,
-                           const std::shared_ptr<Node> &pre_node);
-    void assign_history(std::shared_ptr<Node> &node);
-
-    uint32_t get_history_cost(const std::shared_ptr<Node> &node);
+    uint32_t get_history_cost(uint32_t node) const
+    { return node_history_[node]; }
 
-    double get_presence_cost(const std::shared_ptr<Node> &node,
-                             const std::shared_ptr<Node> &pre_node);
+    double get_presence_cost(uint32_t node, uint32_t pre_node) const {
+        auto const &drivers = node_connections_[node];
+        if (drivers.contains(pre_node))
+            return drivers.size() - 1;
+        else
+            return drivers.size();
+    }
 
     void rip_up_net(int net_id);
-    bool node_owned_net(int net_id, std::shared_ptr<Node> node);
+    // same as rip_up_net but keeps the now empty entry in current_routes,
+    // which has to exist
+    void rip_up_segments(int net_id);
+    bool node_owned_net(int net_id, uint32_t node) const {
+        auto const &net_ids = node_net_ids_[node];
+        return net_ids.empty() ||
+               (net_ids.size() == 1 && net_ids.front() == net_id);
+    }
 
 private:
+    static constexpr uint32_t NOT_OVERUSED = 0xFFFFFFFF;
+
     std::vector<int> squash_net(int src_id);
+    void add_overused(uint32_t node);
+    void remove_overused(uint32_t node);
     // global net id to avoid conflict among different routers when sharing netlist
-    static uint64_t net_id_count_;
+    static std::atomic<uint64_t> net_id_count_;
+    // per-router net ids, see set_net_id_base
+    std::optional<int> next_net_id_;
 };
 
 class UnableRouteException : public std::runtime_error {
@@ -171,5 +462,152 @@ public:
         : std::runtime_error(msg) {}
 };
 
+template <typename EndF, typename CostF, typename HeuristicF>
+std::vector<uint32_t>
+Router::route_a_star(uint32_t start, const EndF &end_f, const CostF &cost_f,
+                     const HeuristicF &h_f, int req_regs,
+                     const BoundingBox *box, const TileMask *mask) {
+    return route_a_star(std::vector<std::pair<uint32_t, double>>{{start, 0}},
+                        end_f, cost_f, h_f, req_regs, box, mask);
+}
+
+template <typename EndF, typename CostF, typename HeuristicF>
+std::vector<uint32_t>
+Router::route_a_star(const std::vector<std::pair<uint32_t, double>> &seeds,
+                     const EndF &end_f, const CostF &cost_f,
+                     const HeuristicF &h_f, int req_regs,
+                     const BoundingBox *box, const TileMask *mask) {
+    auto const &g = *graph_;
+    if (seeds.empty())
+        throw std::runtime_error("no seed to route from");
+    // search states are (node, number of register muxes on the path so far,
+    // capped at req_regs), laid out as node * num_labels + regs. a register
+    // mux is available when it's entered from a switch box. the goal has to
+    // be reached with all the labels collected, so a single search is enough
+    auto const num_labels = static_cast<uint32_t>(std::max(req_regs, 0)) + 1;
+    auto &ws = SearchWorkspace::get();
+    ws.reset(g.size() * num_labels);
+
+    auto &open_list = ws.open_list;
+    uint64_t heap_pushes = 0;
+    // the seeds start with no registers. they have no predecessor, which is
+    // where the path tracing stops
+    for (auto const &[node, cost]: seeds) {
+        auto const state = node * num_labels;
+        double const f = cost + h_f(node);
+        if (!open_list.contains(state)) {
+            ws.set_score(state, cost, f);
+            open_list.push(state, f);
+            heap_pushes++;
+        } else if (cost < ws.g_score(state)) {
+            ws.set_score(state, cost, f);
+            open_list.decrease(state, f);
+        }
+        ws.set_trace(state, CompiledGraph::INVALID_ID);
+        ws.set_path_signature(state, SearchWorkspace::signature_bit(node));
+    }
+
+    // with multiple labels a node can be reached more than once. make sure
+    // the route doesn't run into itself. the path only goes through visited
+    // states with at most as many registers, and the signature rules out
+    // most of the others, so the trace is rarely walked.
+    // states are not pruned by the ones at the same node with more registers:
+    // their path may block the only way to the sink
+    auto on_path = [&](uint32_t state, uint32_t node) -> bool {
+        bool reached = false;
+        for (uint32_t r = 0; r <= state % num_labels && !reached; r++)
+            reached = ws.visited(node * num_labels + r);
+        if (!reached || !(ws.path_signature(state) &
+                          SearchWorkspace::signature_bit(node)))
+            return false;
+        for (; state != CompiledGraph::INVALID_ID; state = ws.trace(state)) {
+            if (state / num_labels == node)
+                return true;
+        }
+        return false;
+    };
+
+    uint32_t end_state = CompiledGraph::INVALID_ID;
+    uint64_t nodes_expanded = 0;
+
+    while (!open_list.empty()) {
+
+        // get the one with lowest cost
+        auto const state = open_list.top();
+        auto const head = state / num_labels;
+        auto const regs = state % num_labels;
+
+        if (regs == num_labels - 1 && end_f(head)) {
+            end_state = state;
+            break;
+        }
+
+        // every state is in the open list at most once, so it can't be
+        // visited already
+        open_list.pop();
+        ws.visit(state);
+        nodes_expanded++;
+
+        auto const is_sb = g.type(head) == NodeType::SwitchBox;
+        for (auto const &edge : g.edges(head)) {
+            auto const node = edge.node;
+            if (box && !box->contains(g.x(node), g.y(node)))
+                continue;
+            if (mask && !mask->contains(g.x(node), g.y(node)))
+                continue;
+            auto next_regs = regs;
+            if (is_sb && next_regs + 1 < num_labels &&
+                g.type(node) == NodeType::Generic)
+                next_regs++;
+            auto const next_state = node * num_labels + next_regs;
+
+            if (ws.visited(next_state))
+                continue;
+            if (num_labels > 1 && on_path(state, node))
+                continue;
+
+            double tentative_score = ws.g_score(state)
+                                     + edge.cost
+                                     + cost_f(head, edge);
+
+            if (!open_list.contains(next_state)) {
+                ws.set_score(next_state, tentative_score,
+                             tentative_score + h_f(node));
+                open_list.push(next_state, ws.f_score(next_state));
+                heap_pushes++;
+            } else if (tentative_score >= ws.g_score(next_state)) {
+                continue;
+            } else {
+                // h_f only depends on the node, so f can only decrease
+                ws.set_score(next_state, tentative_score,
+                             tentative_score + h_f(node));
+                open_list.decrease(next_state, ws.f_score(next_state));
+            }
+            ws.set_trace(next_state, state);
+            if (num_labels > 1)
+                ws.set_path_signature(next_state,
+                                      ws.path_signature(state) |
+                                      SearchWorkspace::signature_bit(node));
+        }
+
+    }
+
+    last_nodes_expanded_ = nodes_expanded;
+    nodes_expanded_ += nodes_expanded;
+    heap_pushes_ += heap_pushes;
+    num_searches_++;
+
+    if (end_state == CompiledGraph::INVALID_ID) {
+        throw UnableRouteException("unable to route from "
+                                   + g.get_node(seeds.front().first)->to_string() + " req_regs " + std::to_string(req_regs));
+    }
+
+    std::vector<uint32_t> routed_path;
+    for (auto state = end_state; state != CompiledGraph::INVALID_ID;
+         state = ws.trace(state))
+        routed_path.emplace_back(state / num_labels);
+    std::reverse(routed_path.begin(), routed_path.end());
+    return routed_path;
+}
 
 #endif //CYCLONE_ROUTE_HH
@@ -0,0 +1,63 @@
+#include "thread_pool.hh"
+
+ThreadPool::ThreadPool(uint32_t num_threads) {
+    for (uint32_t i = 1; i < num_threads; i++)
+        workers_.emplace_back(&ThreadPool::work, this);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        stop_ = true;
+    }
+    start_.notify_all();
+    for (auto &worker: workers_)
+        worker.join();
+}
+
+void ThreadPool::run(uint32_t count,
+                     const std::function<void(uint32_t)> &task) {
+    if (workers_.empty() || count <= 1) {
+        for (uint32_t i = 0; i < count; i++)
+            task(i);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        task_ = &task;
+        count_ = count;
+        next_ = 0;
+        busy_ = static_cast<uint32_t>(workers_.size());
+        generation_++;
+    }
+    start_.notify_all();
+    drain();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this]() { return busy_ == 0; });
+    task_ = nullptr;
+}
+
+void ThreadPool::work() {
+    uint64_t generation = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            start_.wait(lock, [&]() {
+                return stop_ || generation_ != generation;
+            });
+            if (stop_)
+                return;
+            generation = generation_;
+        }
+        drain();
+        std::lock_guard<std::mutex> guard(mutex_);
+        if (--busy_ == 0)
+            done_.notify_one();
+    }
+}
+
+void ThreadPool::drain() {
+    for (auto i = next_++; i < count_; i = next_++)
+        (*task_)(i);
+}
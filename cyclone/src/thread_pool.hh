@@ -0,0 +1,47 @@
+#ifndef CYCLONE_THREAD_POOL_HH
+#define CYCLONE_THREAD_POOL_HH
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// fixed-size pool of worker threads. run() hands out the indices
+// [0, count) to the workers and the calling thread, and returns once all of
+// them are done. the workers are kept alive between runs so that their
+// thread-local state, e.g. the search workspaces, is reused.
+// tasks must not throw
+class ThreadPool {
+public:
+    // num_threads includes the calling thread
+    explicit ThreadPool(uint32_t num_threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    uint32_t num_threads() const
+    { return static_cast<uint32_t>(workers_.size()) + 1; }
+
+    void run(uint32_t count, const std::function<void(uint32_t)> &task);
+
+private:
+    std::vector<std::thread> workers_;
+
+    std::mutex mutex_;
+    std::condition_variable start_;
+    std::condition_variable done_;
+    const std::function<void(uint32_t)> *task_ = nullptr;
+    uint32_t count_ = 0;
+    std::atomic<uint32_t> next_ = 0;
+    uint32_t busy_ = 0;
+    uint64_t generation_ = 0;
+    bool stop_ = false;
+
+    void work();
+    void drain();
+};
+
+#endif //CYCLONE_THREAD_POOL_HH
@@ -607,10 +607,8 @@ void TimingAnalysis::adjust_pipeline_registers() {
             // compute the new current segment
             std::shared_ptr<Node> target_reg_node = nullptr;
             {
-                auto sb_out_internal = current_routed_graph.get_internal_node(current_route[idx]);
-                auto rmux_internal = current_routed_graph.get_internal_node(current_route[idx + 1]);
                 // cut the
-                sb_out_internal->remove_edge(rmux_internal);
+                current_routed_graph.remove_connection(current_route[idx], current_route[idx + 1]);
                 // need to find that register node
                 for (auto const &n: *current_route[idx]) {
                     auto const &node = n.lock();
@@ -658,16 +656,17 @@ void TimingAnalysis::set_layout(const std::string &path) {
     layout_ = load_layout(path);
 }
 
-uint64_t TimingAnalysis::get_delay(const Node *node) const {
+uint64_t get_timing_delay(const Node *node, const Layout &layout,
+                          const std::unordered_map<TimingCost, uint64_t> &timing_cost) {
     switch (node->type) {
         case NodeType::Port: {
-            auto clb_type = layout_.get_blk_type(node->x, node->y);
+            auto clb_type = layout.get_blk_type(node->x, node->y);
             switch (clb_type) {
                 case 'p':
-                    return timing_cost_.at(TimingCost::CLB_OP);
+                    return timing_cost.at(TimingCost::CLB_OP);
                 case 'm':
                     // assume memory is registered
-                    return timing_cost_.at(TimingCost::MEM);
+                    return timing_cost.at(TimingCost::MEM);
                 case 'i':
                 case 'I': return 0;
                 default:
@@ -675,7 +674,7 @@ uint64_t TimingAnalysis::get_delay(const Node *node) const {
             }
         }
         case NodeType::Register: {
-            return timing_cost_.at(TimingCost::REG);
+            return timing_cost.at(TimingCost::REG);
         }
         case NodeType::SwitchBox: {
             // need to determine if it's input or output, and the location
@@ -684,12 +683,12 @@ uint64_t TimingAnalysis::get_delay(const Node *node) const {
                 return 0;
             } else {
                 // need to figure out the tile type
-                auto clb_type = layout_.get_blk_type(node->x, node->y);
+                auto clb_type = layout.get_blk_type(node->x, node->y);
                 switch (clb_type) {
                     case 'p':
-                        return timing_cost_.at(TimingCost::CLB_SB);
+                        return timing_cost.at(TimingCost::CLB_SB);
                     case 'm':
-                        return timing_cost_.at(TimingCost::MEM_SB);
+                        return timing_cost.at(TimingCost::MEM_SB);
                     case 'i':
                         return 0;
                     default:
@@ -698,13 +697,34 @@ uint64_t TimingAnalysis::get_delay(const Node *node) const {
             }
         }
         case NodeType::Generic: {
-            return timing_cost_.at(TimingCost::RMUX);
+            return timing_cost.at(TimingCost::RMUX);
         }
         default:
             throw std::runtime_error("Unable to identify node to compute delay");
     }
 }
 
+std::vector<uint64_t> get_node_timing_delays(const CompiledGraph &graph, const Layout &layout,
+                                             const std::unordered_map<TimingCost, uint64_t> &timing_cost) {
+    std::vector<uint64_t> result(graph.size(), 0);
+    for (uint32_t id = 0; id < graph.size(); id++) {
+        auto const &node = graph.get_node(id);
+        if (!node)
+            continue;
+        try {
+            result[id] = get_timing_delay(node.get(), layout, timing_cost);
+        } catch (const std::runtime_error &) {
+            // not on any timing path
+            result[id] = 0;
+        }
+    }
+    return result;
+}
+
+uint64_t TimingAnalysis::get_delay(const Node *node) const {
+    return get_timing_delay(node, layout_, timing_cost_);
+}
+
 uint64_t TimingAnalysis::maximum_delay() const {
     // the frequency is in mhz
     auto ns = 1'000'000 / min_frequency_;
@@ -30,6 +30,18 @@ inline std::unordered_map<TimingCost, uint64_t> get_default_timing_info() {
 }
 
 
+// delay of a single node from the timing cost model. the tile type is
+// looked up from the layout
+uint64_t get_timing_delay(const Node *node, const Layout &layout,
+                          const std::unordered_map<TimingCost, uint64_t> &timing_cost);
+
+// delay of every node in the graph, indexed by node id, for the
+// timing-driven routing. see GlobalRouter::set_timing_delays. nodes that the
+// model can't classify, e.g. the ones on empty tiles, have no delay
+std::vector<uint64_t> get_node_timing_delays(const CompiledGraph &graph, const Layout &layout,
+                                             const std::unordered_map<TimingCost, uint64_t> &timing_cost);
+
+
 class TimingAnalysis {
 public:
     explicit TimingAnalysis(const std::map<uint32_t, std::unique_ptr<Router>> &routers) : routers_(routers) {}
@@ -0,0 +1,132 @@
+#include <set>
+#include "test_util.hh"
+#include "../src/coarse.hh"
+
+using std::pair;
+using std::set;
+using std::vector;
+
+constexpr SwitchBoxSide SIDES[] = {SwitchBoxSide::Right, SwitchBoxSide::Bottom,
+                                   SwitchBoxSide::Left, SwitchBoxSide::Top};
+
+// the capacity is the number of outgoing tracks wired to the neighbor
+void test_capacity() {
+    auto g = make_grid(4, 3, 3);
+    CompiledGraph graph(g);
+    CoarseRouter router(graph);
+    CHECK(router.width() == 4 && router.height() == 3);
+
+    for (uint32_t x = 0; x < 4; x++) {
+        for (uint32_t y = 0; y < 3; y++) {
+            bool const right = x + 1 < 4, left = x > 0;
+            bool const bottom = y + 1 < 3, top = y > 0;
+            CHECK(router.capacity(x, y, SwitchBoxSide::Right) == right * 3u);
+            CHECK(router.capacity(x, y, SwitchBoxSide::Left) == left * 3u);
+            CHECK(router.capacity(x, y, SwitchBoxSide::Bottom) == bottom * 3u);
+            CHECK(router.capacity(x, y, SwitchBoxSide::Top) == top * 3u);
+            for (auto const side : SIDES)
+                CHECK(router.usage(x, y, side) == 0);
+        }
+    }
+    CHECK(router.capacity(4, 0, SwitchBoxSide::Left) == 0);
+
+    // an extra wire on a track that is already wired doesn't add any
+    // capacity, and wires across more than one tile don't count
+    g.add_edge(make_sb(0, 0, 0, SwitchBoxSide::Bottom, SwitchBoxIO::SB_OUT),
+               make_sb(0, 1, 1, SwitchBoxSide::Top, SwitchBoxIO::SB_IN));
+    g.add_edge(make_sb(0, 0, 0, SwitchBoxSide::Top, SwitchBoxIO::SB_OUT),
+               make_sb(3, 2, 1, SwitchBoxSide::Top, SwitchBoxIO::SB_IN));
+    CompiledGraph extra_graph(g);
+    CoarseRouter extra(extra_graph);
+    CHECK(extra.capacity(0, 0, SwitchBoxSide::Bottom) == 3);
+    CHECK(extra.capacity(0, 0, SwitchBoxSide::Top) == 0);
+}
+
+// a net uses a channel once, and the nets avoid the full channels when it's
+// cheaper to go around
+void test_usage() {
+    auto g = make_grid(3, 3, 1);
+    CompiledGraph graph(g);
+    CoarseRouter router(graph);
+
+    // the second connection branches off the first one
+    router.route_net(0, {{0, 1}, {2, 1}, {1, 1}}, 1);
+    CHECK(router.usage(0, 1, SwitchBoxSide::Right) == 1);
+    CHECK(router.usage(1, 1, SwitchBoxSide::Right) == 1);
+    uint32_t total = 0;
+    for (uint32_t x = 0; x < 3; x++) {
+        for (uint32_t y = 0; y < 3; y++) {
+            for (auto const side : SIDES)
+                total += router.usage(x, y, side);
+        }
+    }
+    CHECK(total == 2);
+    CHECK(router.get_overused_channels() == 0);
+
+    router.route_net(1, {{0, 1}, {2, 1}}, 10);
+    CHECK(router.get_overused_channels() == 0);
+    CHECK(router.usage(0, 1, SwitchBoxSide::Right) == 1);
+    auto const corridor = router.get_corridor(1, 1, 0);
+    CHECK(!corridor.contains(1, 1));
+
+    // sharing is only paid for if it's cheaper than the detour
+    router.route_net(2, {{0, 1}, {2, 1}}, 0.5);
+    CHECK(router.get_overused_channels() == 2);
+    CHECK(router.usage(0, 1, SwitchBoxSide::Right) == 2);
+
+    router.rip_up_net(2);
+    router.rip_up_net(1);
+    router.rip_up_net(0);
+    for (uint32_t x = 0; x < 3; x++) {
+        for (uint32_t y = 0; y < 3; y++) {
+            for (auto const side : SIDES)
+                CHECK(router.usage(x, y, side) == 0);
+        }
+    }
+}
+
+// the corridor holds the src and the tiles of the first connections,
+// widened by the margin
+void test_corridor() {
+    auto g = make_grid(5, 4, 2);
+    CompiledGraph graph(g);
+    CoarseRouter router(graph);
+    router.route_net(7, {{0, 0}, {3, 0}, {3, 2}}, 1);
+
+    auto expect = [&](const vector<pair<uint32_t, uint32_t>> &tiles,
+                      uint32_t num_connections, uint32_t margin) {
+        auto const corridor = router.get_corridor(7, num_connections, margin);
+        for (uint32_t x = 0; x < 6; x++) {
+            for (uint32_t y = 0; y < 5; y++) {
+                bool near = false;
+                for (auto const &[tx, ty] : tiles) {
+                    auto const dx = x > tx ? x - tx : tx - x;
+                    auto const dy = y > ty ? y - ty : ty - y;
+                    near = near || (dx <= margin && dy <= margin);
+                }
+                bool const in_grid = x < 5 && y < 4;
+                CHECK(corridor.contains(x, y) == (near && in_grid));
+            }
+        }
+    };
+    vector<pair<uint32_t, uint32_t>> tiles = {{0, 0}};
+    expect(tiles, 0, 0);
+    expect(tiles, 0, 1);
+    tiles.insert(tiles.end(), {{1, 0}, {2, 0}, {3, 0}});
+    expect(tiles, 1, 0);
+    tiles.insert(tiles.end(), {{3, 1}, {3, 2}});
+    expect(tiles, 2, 0);
+    expect(tiles, 2, 1);
+    expect(tiles, 10, 2);
+
+    // unknown nets get an empty corridor
+    auto const corridor = router.get_corridor(8, 1, 1);
+    CHECK(!corridor.contains(0, 0));
+}
+
+int main() {
+    test_capacity();
+    test_usage();
+    test_corridor();
+    return 0;
+}
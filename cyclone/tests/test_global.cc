@@ -0,0 +1,216 @@
+#include <random>
+#include <set>
+#include "test_util.hh"
+#include "../src/global.hh"
+
+using std::map;
+using std::pair;
+using std::set;
+using std::string;
+using std::vector;
+
+constexpr uint32_t SIZE = 8;
+
+string block(uint32_t x, uint32_t y) {
+    return "p" + std::to_string(x) + "_" + std::to_string(y);
+}
+
+// random two and three pin nets. every input is used at most once
+vector<vector<pair<string, string>>> make_netlist(uint32_t num_nets) {
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<uint32_t> pos(0, SIZE - 1);
+    set<pair<string, string>> used;
+    vector<vector<pair<string, string>>> netlist;
+    while (netlist.size() < num_nets) {
+        auto const src = block(pos(rng), pos(rng));
+        if (!used.emplace(src, "out").second)
+            continue;
+        vector<pair<string, string>> net = {{src, "out"}};
+        auto const num_sinks = 1 + rng() % 2;
+        while (net.size() < num_sinks + 1) {
+            pair<string, string> sink = {block(pos(rng), pos(rng)),
+                                         rng() % 2 ? "in0" : "in1"};
+            if (sink.first != src && used.emplace(sink).second)
+                net.emplace_back(sink);
+        }
+        netlist.emplace_back(net);
+    }
+    return netlist;
+}
+
+map<string, vector<vector<string>>>
+route(const RoutingGraph &g,
+      const vector<vector<pair<string, string>>> &netlist,
+      uint32_t num_threads) {
+    GlobalRouter r(40, g);
+    r.num_threads = num_threads;
+    for (uint32_t x = 0; x < SIZE; x++) {
+        for (uint32_t y = 0; y < SIZE; y++)
+            r.add_placement(x, y, block(x, y));
+    }
+    for (uint32_t i = 0; i < netlist.size(); i++)
+        r.add_net("n" + std::to_string(i), netlist[i]);
+    r.route();
+
+    map<string, vector<vector<string>>> result;
+    for (auto const &[name, segments] : r.realize()) {
+        auto &route = result[name];
+        for (auto const &segment : segments) {
+            route.emplace_back();
+            for (auto const &node : segment)
+                route.back().emplace_back(node->to_string());
+        }
+    }
+    return result;
+}
+
+void test_determinism() {
+    auto const g = make_grid(SIZE, SIZE, 3);
+    auto const netlist = make_netlist(50);
+    // the same number of threads gives the same routes every time, and so
+    // does any other number larger than 1
+    auto const routes = route(g, netlist, 4);
+    CHECK(routes.size() == netlist.size());
+    CHECK(route(g, netlist, 4) == routes);
+    CHECK(route(g, netlist, 3) == routes);
+
+    auto const serial = route(g, netlist, 1);
+    CHECK(serial.size() == netlist.size());
+    CHECK(route(g, netlist, 1) == serial);
+}
+
+class TestGlobalRouter : public GlobalRouter {
+public:
+    using GlobalRouter::GlobalRouter;
+    using GlobalRouter::build_timing_graph;
+    using GlobalRouter::compute_criticality;
+    using GlobalRouter::reuse_route;
+    using GlobalRouter::rip_up_net;
+    using GlobalRouter::rip_up_segments;
+};
+
+// i0 drives p0 and p1, p0 drives p1 and p1 drives i1 through a pipeline
+// register. every node costs 1, excluding the src of the route
+void test_timing() {
+    auto g = make_grid(4, 1, 1);
+    RegisterNode reg("reg", 2, 0, 1, 0);
+    auto sb = [&](uint32_t x, SwitchBoxSide side, SwitchBoxIO io) {
+        return g.get_sb(x, 0, side, 0, io);
+    };
+    auto right = [&](uint32_t x) {
+        return sb(x, SwitchBoxSide::Right, SwitchBoxIO::SB_OUT);
+    };
+    auto left = [&](uint32_t x) {
+        return sb(x, SwitchBoxSide::Left, SwitchBoxIO::SB_IN);
+    };
+    g.add_edge(*right(2), reg);
+    g.add_edge(reg, *left(3));
+
+    TestGlobalRouter r(1, g);
+    r.add_placement(0, 0, "i0");
+    r.add_placement(1, 0, "p0");
+    r.add_placement(2, 0, "p1");
+    r.add_placement(3, 0, "i1");
+    r.add_net("n0", {{"i0", "out"}, {"p0", "in0"}, {"p1", "in1"}});
+    r.add_net("n1", {{"p0", "out"}, {"p1", "in0"}});
+    r.add_net("n2", {{"p1", "out"}, {"i1", "in0"}});
+    map<string, int> ids;
+    for (auto const &[id, net] : r.get_netlist())
+        ids[net.name] = id;
+    auto const &netlist = r.get_netlist();
+    auto pin = [&](const string &net, uint32_t seg_index) {
+        return netlist.at(ids.at(net))[seg_index].id;
+    };
+
+    // the second sink of n0 branches off its first segment at left(1)
+    auto port = [&](uint32_t x, const string &name) {
+        return g.get_port(x, 0, name);
+    };
+    map<int, map<uint32_t, vector<std::shared_ptr<Node>>>> routes;
+    routes[ids["n0"]][pin("n0", 1)] = {port(0, "out"), right(0), left(1),
+                                       port(1, "in0")};
+    routes[ids["n0"]][pin("n0", 2)] = {left(1), right(1), left(2),
+                                       port(2, "in1")};
+    routes[ids["n1"]][pin("n1", 1)] = {port(1, "out"), right(1), left(2),
+                                       port(2, "in0")};
+    std::shared_ptr<Node> reg_node;
+    for (auto const &node : *right(2)) {
+        if (node.lock()->type == NodeType::Register)
+            reg_node = node.lock();
+    }
+    routes[ids["n2"]][pin("n2", 1)] = {port(2, "out"), right(2), reg_node,
+                                       left(3), port(3, "in0")};
+    r.set_current_routes(routes);
+    r.set_timing_delays(vector<uint64_t>(r.get_graph()->size(), 1));
+    r.build_timing_graph();
+    r.compute_criticality();
+
+    // p0 arrives at 3, p1 at max(3 + 3, 5) = 6, and the path ends at the
+    // register 1 later
+    CHECK(r.get_critical_path_delay() == 7);
+    CHECK(r.get_criticality(ids["n0"], 1) == 1);
+    CHECK(r.get_criticality(ids["n1"], 1) == 1);
+    CHECK(r.get_criticality(ids["n2"], 1) == 1);
+    // 5 to p1 and 1 to the register
+    CHECK(r.get_criticality(ids["n0"], 2) == 6.0 / 7);
+
+    // once the connection from p0 takes no time the branch of n0 becomes
+    // critical, and the path through p0 is 3 + 0 + 1
+    routes[ids["n1"]][pin("n1", 1)] = {port(1, "out")};
+    r.set_current_routes(routes);
+    r.build_timing_graph();
+    r.compute_criticality();
+    CHECK(r.get_critical_path_delay() == 6);
+    CHECK(r.get_criticality(ids["n0"], 2) == 1);
+    CHECK(r.get_criticality(ids["n0"], 1) == 4.0 / 6);
+}
+
+// two nets of the same kind one row apart. the second one takes the
+// translated route of the first unless a node of it is taken
+void test_route_reuse() {
+    auto const g = make_grid(4, 2, 2);
+    TestGlobalRouter r(1, g);
+    for (uint32_t x = 0; x < 4; x++) {
+        for (uint32_t y = 0; y < 2; y++)
+            r.add_placement(x, y, block(x, y));
+    }
+    r.add_net("n0", {{block(0, 0), "out"}, {block(3, 0), "in0"}});
+    r.add_net("n1", {{block(0, 1), "out"}, {block(3, 1), "in0"}});
+    map<string, int> ids;
+    for (auto const &[id, net] : r.get_netlist())
+        ids[net.name] = id;
+    r.route();
+    CHECK(r.get_iteration_stats().front().routes_reused == 1);
+
+    auto const &graph = *r.get_graph();
+    auto routes = r.realize();
+    auto const &first = routes.at("n0").front();
+    auto const &second = routes.at("n1").front();
+    CHECK(first.size() == second.size());
+    for (uint64_t i = 0; i < first.size(); i++) {
+        auto const id = graph.get_id(first[i]);
+        CHECK(graph.translate(id, 0, 1) == graph.get_id(second[i]));
+    }
+
+    // n0 takes a node of the translated route, which has to be rejected
+    r.rip_up_segments(ids["n1"]);
+    r.rip_up_segments(ids["n0"]);
+    std::map<uint32_t, vector<std::shared_ptr<Node>>> blocker = {
+            {r.get_netlist().at(ids["n0"])[1].id, {second[1]}}};
+    r.update_net_route(ids["n0"], blocker);
+    r.assign_net_segment(blocker.begin()->second, ids["n0"]);
+    CHECK(!r.reuse_route(ids["n1"], nullptr));
+    CHECK(r.get_congested_nets().empty());
+
+    // and accepted once the node is free again
+    r.rip_up_net(ids["n0"]);
+    CHECK(r.reuse_route(ids["n1"], nullptr));
+    CHECK(r.get_congested_nets().empty());
+}
+
+int main() {
+    test_determinism();
+    test_timing();
+    test_route_reuse();
+    return 0;
+}
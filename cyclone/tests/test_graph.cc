@@ -0,0 +1,139 @@
+#include "test_util.hh"
+#include "../src/route.hh"
+
+class TestRouter : public Router {
+public:
+    using Router::Router;
+    using Router::route_a_star;
+};
+
+void test_edge_cost() {
+    RoutingGraph g = make_grid(2, 1, 1);
+    auto out = g.get_port(0, 0, "out");
+    auto in = g.get_port(1, 0, "in0");
+
+    // existing edges cost the delay of the node they lead to plus the wire
+    // delay, missing ones report the sentinel
+    auto right = g.get_sb(0, 0, SwitchBoxSide::Right, 0, SwitchBoxIO::SB_OUT);
+    auto left = g.get_sb(1, 0, SwitchBoxSide::Left, 0, SwitchBoxIO::SB_IN);
+    CHECK(right->get_edge_cost(left) == left->delay + 1);
+    CHECK(out->get_edge_cost(right) == right->delay);
+    CHECK(out->get_edge_cost(in) == 0xFFFFFF);
+
+    // a direct but slow wire has to lose to the switch box path
+    g.add_edge(*out, *in, 10);
+    CHECK(out->get_edge_cost(in) == in->delay + 10);
+
+    auto graph = std::make_shared<const CompiledGraph>(g);
+    bool found = false;
+    for (auto const &edge : graph->edges(graph->get_id(out))) {
+        if (edge.node == graph->get_id(in)) {
+            CHECK(edge.cost == in->delay + 10);
+            found = true;
+        }
+    }
+    CHECK(found);
+
+    TestRouter r(graph);
+    auto path = r.route_a_star(out, in);
+    CHECK(path.size() == 4);
+    CHECK(path.front() == out);
+    CHECK(path[1] == right);
+    CHECK(path[2] == left);
+    CHECK(path.back() == in);
+}
+
+// compares the precomputed flag against a brute force check over every
+// pair of nodes
+void test_near_register() {
+    RoutingGraph g = make_grid(3, 2, 2);
+    RegisterNode reg0("reg0", 1, 0, 1, 0);
+    RegisterNode reg1("reg1", 2, 1, 1, 0);
+    g.add_edge(make_sb(1, 0, 0, SwitchBoxSide::Right, SwitchBoxIO::SB_OUT),
+               reg0);
+    g.add_edge(reg0, make_sb(1, 0, 1, SwitchBoxSide::Right,
+                             SwitchBoxIO::SB_OUT));
+    g.add_edge(*g.get_port(2, 1, "out"), reg1);
+
+    auto graph = std::make_shared<const CompiledGraph>(g);
+    auto const &cg = *graph;
+    std::vector<uint32_t> regs;
+    for (uint32_t id = 0; id < cg.size(); id++) {
+        if (cg.type(id) == NodeType::Register)
+            regs.emplace_back(id);
+    }
+    CHECK(regs.size() == 2);
+    auto const one_hop = [&](uint32_t id) {
+        for (auto const reg : regs) {
+            if (cg.has_edge(id, reg))
+                return true;
+        }
+        return false;
+    };
+    uint32_t num_near = 0;
+    for (uint32_t id = 0; id < cg.size(); id++) {
+        bool expected = one_hop(id);
+        for (uint32_t next = 0; next < cg.size() && !expected; next++)
+            expected = cg.has_edge(id, next) && one_hop(next);
+        CHECK(cg.near_register(id) == expected);
+        if (expected)
+            num_near++;
+    }
+    CHECK(num_near > 0 && num_near < cg.size());
+
+    // three hops away: sb out of (0, 0) -> sb in of (1, 0) -> sb out -> reg
+    auto const far = cg.get_id(g.get_sb(0, 0, SwitchBoxSide::Right, 0,
+                                        SwitchBoxIO::SB_OUT));
+    CHECK(!cg.near_register(far));
+    auto const near = cg.get_id(g.get_sb(1, 0, SwitchBoxSide::Left, 0,
+                                         SwitchBoxIO::SB_IN));
+    CHECK(cg.near_register(near));
+}
+
+// every node translates to the same node of another tile of the same kind
+// and back. the tile with an extra register is of its own kind
+void test_translate() {
+    RoutingGraph g = make_grid(4, 3, 2);
+    RegisterNode reg("reg", 2, 1, 1, 0);
+    g.add_edge(make_sb(2, 1, 0, SwitchBoxSide::Right, SwitchBoxIO::SB_OUT),
+               reg);
+    auto graph = std::make_shared<const CompiledGraph>(g);
+    auto const &cg = *graph;
+    CHECK(cg.tile_signature(0, 0) == cg.tile_signature(3, 2));
+    CHECK(cg.tile_signature(0, 0) != cg.tile_signature(2, 1));
+    CHECK(cg.tile_signature(4, 0) == CompiledGraph::INVALID_ID);
+
+    uint32_t num_translated = 0;
+    for (uint32_t id = 0; id < cg.size(); id++) {
+        for (int64_t dx = -4; dx <= 4; dx++) {
+            for (int64_t dy = -3; dy <= 3; dy++) {
+                auto const x = static_cast<int64_t>(cg.x(id)) + dx;
+                auto const y = static_cast<int64_t>(cg.y(id)) + dy;
+                auto const node = cg.translate(id, dx, dy);
+                bool const valid =
+                        x >= 0 && x < 4 && y >= 0 && y < 3 &&
+                        cg.tile_signature(cg.x(id), cg.y(id)) ==
+                        cg.tile_signature(x, y);
+                CHECK((node != CompiledGraph::INVALID_ID) == valid);
+                if (!valid)
+                    continue;
+                num_translated++;
+                CHECK(cg.x(node) == x && cg.y(node) == y);
+                CHECK(cg.type(node) == cg.type(id));
+                CHECK(cg.track(node) == cg.track(id));
+                CHECK(cg.side(node) == cg.side(id));
+                CHECK(cg.io(node) == cg.io(id));
+                CHECK(cg.get_node(node)->name == cg.get_node(id)->name);
+                CHECK(cg.translate(node, -dx, -dy) == id);
+            }
+        }
+    }
+    CHECK(num_translated > cg.size());
+}
+
+int main() {
+    test_edge_cost();
+    test_near_register();
+    test_translate();
+    return 0;
+}
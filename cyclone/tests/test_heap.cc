@@ -0,0 +1,105 @@
+#include <algorithm>
+#include <limits>
+#include <random>
+#include "test_util.hh"
+#include "../src/heap.hh"
+
+using std::pair;
+using std::vector;
+
+void test_indexed_heap() {
+    constexpr uint32_t num_nodes = 1000;
+    IndexedHeap<double> heap;
+    heap.reserve(num_nodes);
+
+    std::mt19937 rng(0);
+    std::uniform_int_distribution<uint32_t> dist(0, 100);
+    vector<double> keys(num_nodes);
+    for (uint32_t node = 0; node < num_nodes; node++) {
+        keys[node] = dist(rng);
+        heap.push(node, keys[node]);
+    }
+    CHECK(heap.size() == num_nodes);
+    // decrease every third key, some of them to the same value
+    for (uint32_t node = 0; node < num_nodes; node += 3) {
+        keys[node] = std::min<double>(keys[node], dist(rng) / 2);
+        heap.decrease(node, keys[node]);
+    }
+
+    vector<pair<double, uint32_t>> expected;
+    for (uint32_t node = 0; node < num_nodes; node++)
+        expected.emplace_back(keys[node], node);
+    std::sort(expected.begin(), expected.end());
+
+    // popped by key, ties by node id
+    for (auto const &[key, node] : expected) {
+        CHECK(!heap.empty());
+        CHECK(heap.top() == node);
+        CHECK(heap.top_key() == key);
+        CHECK(heap.contains(node));
+        heap.pop();
+        CHECK(!heap.contains(node));
+    }
+    CHECK(heap.empty());
+
+    // clear only resets the nodes in the heap
+    heap.push(7, 1);
+    heap.push(3, 2);
+    heap.clear();
+    CHECK(heap.empty());
+    CHECK(!heap.contains(7));
+    CHECK(!heap.contains(3));
+    heap.push(3, 5);
+    CHECK(heap.top() == 3);
+}
+
+void test_bucket_queue() {
+    BucketQueue queue;
+    // node 1 is pushed again with a smaller key, the first entry goes stale
+    queue.push(1, 5);
+    queue.push(2, 3);
+    queue.push(1, 2);
+    queue.push(3, 3);
+
+    vector<uint32_t> dist = {3, 2, 3, 3};
+    vector<bool> done(dist.size(), false);
+    vector<uint32_t> order;
+    uint32_t last_key = 0;
+    uint32_t num_stale = 0;
+    while (!queue.empty()) {
+        auto const [key, node] = queue.pop();
+        // keys come out in order
+        CHECK(key >= last_key);
+        last_key = key;
+        if (done[node] || key > dist[node]) {
+            num_stale++;
+            continue;
+        }
+        done[node] = true;
+        order.emplace_back(node);
+        // pushing at the current key is allowed
+        if (node == 2)
+            queue.push(0, key);
+    }
+    CHECK(num_stale == 1);
+    CHECK(order.size() == 4);
+    CHECK(order[0] == 1);
+    CHECK(order.back() != 1);
+    CHECK(done[0] && done[2] && done[3]);
+
+    // clear starts over from key 0
+    queue.push(4, 7);
+    queue.clear();
+    CHECK(queue.empty());
+    queue.push(5, 0);
+    auto const [key, node] = queue.pop();
+    CHECK(key == 0);
+    CHECK(node == 5);
+    CHECK(queue.empty());
+}
+
+int main() {
+    test_indexed_heap();
+    test_bucket_queue();
+    return 0;
+}
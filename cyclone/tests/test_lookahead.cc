@@ -0,0 +1,108 @@
+#include <cstdio>
+#include <functional>
+#include <queue>
+#include "../src/lookahead.hh"
+#include "test_util.hh"
+
+using std::vector;
+
+constexpr uint32_t UNREACHED = 0xFFFFFFFF;
+
+// edge cost of the cheapest path from the node to every other node
+vector<uint32_t> shortest_costs(const CompiledGraph &g, uint32_t source) {
+    vector<uint32_t> cost(g.size(), UNREACHED);
+    using Entry = std::pair<uint32_t, uint32_t>;
+    std::priority_queue<Entry, vector<Entry>, std::greater<>> working_set;
+    cost[source] = 0;
+    working_set.emplace(0, source);
+    while (!working_set.empty()) {
+        auto const [c, head] = working_set.top();
+        working_set.pop();
+        if (c > cost[head])
+            continue;
+        for (auto const &edge: g.edges(head)) {
+            if (c + edge.cost < cost[edge.node]) {
+                cost[edge.node] = c + edge.cost;
+                working_set.emplace(cost[edge.node], edge.node);
+            }
+        }
+    }
+    return cost;
+}
+
+// the tiles are not uniform: a single tile away from the corners and the
+// center has a cheap long wire to the far side of the array
+RoutingGraph make_irregular_grid() {
+    auto g = make_grid(5, 4, 2, 3);
+    g.add_edge(make_sb(1, 2, 0, SwitchBoxSide::Right, SwitchBoxIO::SB_OUT),
+               make_sb(4, 0, 1, SwitchBoxSide::Left, SwitchBoxIO::SB_IN), 0);
+    return g;
+}
+
+// the estimate never exceeds the actual cost, for every pair of nodes
+void test_admissible() {
+    auto routing_graph = make_irregular_grid();
+    auto graph = std::make_shared<const CompiledGraph>(routing_graph);
+    Lookahead lookahead(graph);
+    auto const &g = *graph;
+    uint32_t num_exact = 0;
+    for (uint32_t source = 0; source < g.size(); source++) {
+        auto const cost = shortest_costs(g, source);
+        for (uint32_t sink = 0; sink < g.size(); sink++) {
+            if (cost[sink] == UNREACHED)
+                continue;
+            auto const estimate = lookahead.estimate(source, sink);
+            CHECK(estimate <= cost[sink]);
+            if (estimate == cost[sink] && cost[sink] > 0)
+                num_exact++;
+        }
+    }
+    // and it's not trivially zero
+    CHECK(num_exact > 0);
+
+    // the long wire is taken into account from the tile it starts in
+    auto const out = g.get_id(g.get_port(1, 2, "out"));
+    auto const in = g.get_id(g.get_port(4, 0, "in0"));
+    CHECK(shortest_costs(g, out)[in] == 3);
+    CHECK(lookahead.estimate(out, in) <= 3);
+}
+
+// without any table entry the estimate falls back to the lowest cost per
+// tile crossed, which is still a lower bound
+void test_fallback() {
+    auto routing_graph = make_irregular_grid();
+    auto graph = std::make_shared<const CompiledGraph>(routing_graph);
+    Lookahead lookahead(graph);
+    auto const &g = *graph;
+    auto const node = g.get_id(g.get_port(0, 0, "out"));
+    // outside of the array. the long wire costs 1 over 5 tiles
+    CHECK(lookahead.estimate(node, {10, 0}, NodeType::Port) == 2);
+}
+
+void test_dump_load() {
+    auto routing_graph = make_irregular_grid();
+    auto graph = std::make_shared<const CompiledGraph>(routing_graph);
+    Lookahead lookahead(graph);
+    auto const filename = "test_lookahead.txt";
+    lookahead.dump(filename);
+    auto loaded = Lookahead::load(graph, filename);
+    std::remove(filename);
+    CHECK(loaded);
+    CHECK(loaded->num_rows() == lookahead.num_rows());
+    auto const &g = *graph;
+    for (uint32_t source = 0; source < g.size(); source++) {
+        for (uint32_t sink = 0; sink < g.size(); sink++) {
+            CHECK(loaded->estimate(source, sink) ==
+                  lookahead.estimate(source, sink));
+        }
+        CHECK(loaded->estimate(source, {10, 0}, NodeType::Port) ==
+              lookahead.estimate(source, {10, 0}, NodeType::Port));
+    }
+}
+
+int main() {
+    test_admissible();
+    test_fallback();
+    test_dump_load();
+    return 0;
+}
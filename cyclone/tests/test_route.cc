@@ -0,0 +1,123 @@
+#include <set>
+#include "test_util.hh"
+#include "../src/route.hh"
+
+using std::set;
+using std::shared_ptr;
+using std::vector;
+
+class TestRouter : public Router {
+public:
+    using Router::Router;
+    using Router::route_a_star;
+    using Router::SameNode;
+    using Router::DelayCost;
+};
+
+bool no_repeat(const vector<shared_ptr<Node>> &path) {
+    return set<shared_ptr<Node>>(path.begin(), path.end()).size() == path.size();
+}
+
+// the register mux r is entered from the src first, which doesn't count as
+// a register. the cheapest way to v collects one through b, but then r is
+// on the path already and the sink can't be reached. the route has to take
+// the slow wire a -> v and collect the register at r
+void test_register_chain() {
+    Switch switchbox(0, 0, 2, 2, 1, 0, {});
+    RoutingGraph g(1, 1, switchbox);
+    PortNode src("src", 0, 0, 1);
+    PortNode dst("dst", 0, 0, 1);
+    RegisterMuxNode r("rmux0", 0, 0, 1, 0);
+    RegisterMuxNode rb("rmux1", 0, 0, 1, 0);
+    auto a = make_sb(0, 0, 0, SwitchBoxSide::Left, SwitchBoxIO::SB_IN);
+    auto b = make_sb(0, 0, 0, SwitchBoxSide::Right, SwitchBoxIO::SB_OUT);
+    auto c = make_sb(0, 0, 1, SwitchBoxSide::Right, SwitchBoxIO::SB_OUT);
+    auto v = make_sb(0, 0, 1, SwitchBoxSide::Bottom, SwitchBoxIO::SB_OUT);
+
+    g.add_edge(src, r);
+    g.add_edge(r, b);
+    g.add_edge(b, rb);
+    g.add_edge(rb, v);
+    g.add_edge(src, a);
+    g.add_edge(a, v, 10);
+    g.add_edge(v, r);
+    g.add_edge(r, c);
+    g.add_edge(c, dst);
+
+    TestRouter router(g);
+    auto start = g.get_port(0, 0, "src");
+    auto end = g.get_port(0, 0, "dst");
+    auto sb = [&](const SwitchBoxNode &node) -> shared_ptr<Node> {
+        return g.get_sb(0, 0, node.side, node.track, node.io);
+    };
+
+    // without registers the direct way is fine
+    auto path = router.route_a_star(start, end, zero_cost, 0);
+    CHECK(path.size() == 4);
+    CHECK(path[1]->name == "rmux0");
+
+    path = router.route_a_star(start, end, zero_cost, 1);
+    CHECK(no_repeat(path));
+    CHECK(path.size() == 6);
+    CHECK(path[0] == start);
+    CHECK(path[1] == sb(a));
+    CHECK(path[2] == sb(v));
+    CHECK(path[3]->name == "rmux0");
+    CHECK(path[4] == sb(c));
+    CHECK(path[5] == end);
+
+    // there is no simple path with two registers
+    bool failed = false;
+    try {
+        router.route_a_star(start, end, zero_cost, 2);
+    } catch (const UnableRouteException &) {
+        failed = true;
+    }
+    CHECK(failed);
+}
+
+// the search is seeded with the src and two nodes of the route tree, each
+// with its own cost. the path has to start from the seed with the lowest
+// seed cost plus edge cost to the sink, which is neither the nearest nor
+// the cheapest seed
+void test_multi_source() {
+    auto g = make_grid(4, 1, 1);
+    TestRouter router(g);
+    auto const &graph = *router.get_graph();
+    auto const src = graph.get_id(g.get_port(0, 0, "out"));
+    auto const sink = graph.get_id(g.get_port(3, 0, "in0"));
+    auto const left = [&](uint32_t x) {
+        return graph.get_id(g.get_sb(x, 0, SwitchBoxSide::Left, 0,
+                                     SwitchBoxIO::SB_IN));
+    };
+    auto const route = [&](const vector<std::pair<uint32_t, double>> &seeds) {
+        return router.route_a_star(seeds, TestRouter::SameNode{sink},
+                                   TestRouter::DelayCost{},
+                                   [](uint32_t) { return 0.0; }, 0);
+    };
+
+    // edge costs to the sink: 10 from the src, 7 from left(1), 4 from
+    // left(2)
+    auto path = route({{src, 0}, {left(1), 4}, {left(2), 5}});
+    CHECK(path.front() == left(2));
+    CHECK(path.size() == 4);
+    CHECK(path.back() == sink);
+
+    // the tree is too expensive to branch from
+    path = route({{src, 0}, {left(1), 4}, {left(2), 7}});
+    CHECK(path.front() == src);
+    CHECK(path.size() == 8);
+
+    path = route({{src, 0}, {left(1), 2}, {left(2), 7}});
+    CHECK(path.front() == left(1));
+
+    // a seed listed twice keeps its lower cost
+    path = route({{src, 0}, {left(2), 7}, {left(2), 5}});
+    CHECK(path.front() == left(2));
+}
+
+int main() {
+    test_register_chain();
+    test_multi_source();
+    return 0;
+}
@@ -0,0 +1,77 @@
+#ifndef CYCLONE_TEST_UTIL_HH
+#define CYCLONE_TEST_UTIL_HH
+
+#include <cstdlib>
+#include <iostream>
+#include "../src/graph.hh"
+#include "../src/util.hh"
+
+// the tests are plain executables. a failed check exits with an error so that
+// ctest reports it
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            std::cerr << __FILE__ << ":" << __LINE__                         \
+                      << ": check failed: " #cond << std::endl;              \
+            std::exit(EXIT_FAILURE);                                         \
+        }                                                                    \
+    } while (0)
+
+inline SwitchBoxNode make_sb(uint32_t x, uint32_t y, uint32_t track,
+                             SwitchBoxSide side, SwitchBoxIO io) {
+    return SwitchBoxNode(x, y, 1, track, side, io);
+}
+
+// width x height array where every tile has the ports "in0", "in1" and
+// "out". out drives every outgoing switch box, the incoming ones drive the
+// inputs, the switch boxes are wired disjointly and adjacent tiles are
+// connected on every track. the wires between the tiles cost wire_delay
+inline RoutingGraph make_grid(uint32_t width, uint32_t height,
+                              uint32_t num_track, uint32_t wire_delay = 1) {
+    Switch switchbox(0, 0, num_track, num_track, 1, 0,
+                     get_disjoint_sb_wires(num_track));
+    RoutingGraph g(width, height, switchbox);
+    for (uint32_t x = 0; x < width; x++) {
+        for (uint32_t y = 0; y < height; y++) {
+            PortNode out("out", x, y, 1);
+            for (auto const *name : {"in0", "in1"}) {
+                PortNode in(name, x, y, 1);
+                for (uint32_t track = 0; track < num_track; track++) {
+                    for (uint32_t side = 0; side < Switch::SIDES; side++) {
+                        g.add_edge(make_sb(x, y, track, get_side_int(side),
+                                           SwitchBoxIO::SB_IN), in);
+                    }
+                }
+            }
+            for (uint32_t track = 0; track < num_track; track++) {
+                for (uint32_t side = 0; side < Switch::SIDES; side++) {
+                    g.add_edge(out, make_sb(x, y, track, get_side_int(side),
+                                            SwitchBoxIO::SB_OUT));
+                }
+                if (x + 1 < width) {
+                    g.add_edge(make_sb(x, y, track, SwitchBoxSide::Right,
+                                       SwitchBoxIO::SB_OUT),
+                               make_sb(x + 1, y, track, SwitchBoxSide::Left,
+                                       SwitchBoxIO::SB_IN), wire_delay);
+                    g.add_edge(make_sb(x + 1, y, track, SwitchBoxSide::Left,
+                                       SwitchBoxIO::SB_OUT),
+                               make_sb(x, y, track, SwitchBoxSide::Right,
+                                       SwitchBoxIO::SB_IN), wire_delay);
+                }
+                if (y + 1 < height) {
+                    g.add_edge(make_sb(x, y, track, SwitchBoxSide::Bottom,
+                                       SwitchBoxIO::SB_OUT),
+                               make_sb(x, y + 1, track, SwitchBoxSide::Top,
+                                       SwitchBoxIO::SB_IN), wire_delay);
+                    g.add_edge(make_sb(x, y + 1, track, SwitchBoxSide::Top,
+                                       SwitchBoxIO::SB_OUT),
+                               make_sb(x, y, track, SwitchBoxSide::Bottom,
+                                       SwitchBoxIO::SB_IN), wire_delay);
+                }
+            }
+        }
+    }
+    return g;
+}
+
+#endif //CYCLONE_TEST_UTIL_HH